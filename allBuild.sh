@@ -1,2 +1,3 @@
 rm -f a.out
-find -name '*.cpp' | xargs gcc -Icompiler -lstdc++ -Wall -g -pedantic -Wextra -Wformat -Wconversion -std=c++0x -Wfatal-errors || exit $?
+python compiler/lexer/gen_dfa.py compiler/lexer/tokens.spec compiler/lexer/dfa.inc || exit $?
+find compiler -name '*.cpp' | xargs gcc -Icompiler -lstdc++ -Wall -g -pedantic -Wextra -Wformat -Wconversion -std=c++0x -pthread -Wfatal-errors || exit $?
@@ -0,0 +1,206 @@
+// Edit-to-AST latency of the incremental parser
+//
+// Build with "./build.py bench", run as "./incremental_bench [megabytes]".
+// Applies a few typical edits in the middle of files of growing size,
+// checks the result against a full reparse and prints the average latency
+// of an edit next to the time of a full parse, and then of a long session of
+// typing and deleting single characters.
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "common/config.hpp"
+#include "common/context.hpp"
+#include "common/diagnostics.hpp"
+#include "common/source_manager.hpp"
+#include "ast/decl.hpp"
+#include "ast/type.hpp"
+#include "ast/expr.hpp"
+#include "ast/node_count.hpp"
+#include "parser/incremental_parser.hpp"
+
+using namespace llang;
+using namespace llang::lexer;
+using llang::parser::Edit;
+using llang::parser::IncrementalParser;
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+double secondsSince(Clock::time_point start) {
+	return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+std::string generateSource(size_t bytes) {
+	std::string source = "fn i32 f_0(i32 a, i32 b) = a;\n";
+
+	char line[256];
+	for (size_t i = 1; source.size() < bytes; ++i) {
+		snprintf(line, sizeof(line),
+			"fn i32 f_%zu(i32 a, i32 b) =\n"
+			"\tif (a = b) f_%zu(a * b + %zu, b) else b;\n",
+			i, i - 1, i);
+		source += line;
+	}
+
+	return source;
+}
+
+// Compares the incremental result with parsing the text from scratch
+bool check(Context& context, const IncrementalParser& incremental,
+           const std::string& text) {
+	Config config;
+	SourceManager sources;
+	Diagnostics diag(config, sources);
+	Context fresh(config, diag, sources);
+
+	IncrementalParser full(fresh, "bench");
+	full.parse(sources.addFile("bench.llang",
+		new SourceBuffer(text.data(), text.size())));
+
+	std::vector<Token> a, b;
+	incremental.tokens(a);
+	full.tokens(b);
+	if (a.size() != b.size()) return false;
+
+	for (size_t i = 0; i < a.size(); ++i) {
+		// Reused tokens have locations in older versions
+		PresumedLocation x = context.sources.decode(a[i].location);
+		PresumedLocation y = sources.decode(b[i].location);
+
+		if (a[i].type != b[i].type || a[i].length != b[i].length ||
+		    x.line != y.line || x.column != y.column)
+			return false;
+
+		if (a[i].type == Token::IDENTIFIER) {
+			if (context.identifiers.str(a[i].identifier()) !=
+			    fresh.identifiers.str(b[i].identifier()))
+				return false;
+		} else if (a[i].value != b[i].value) {
+			return false;
+		}
+	}
+
+	return ast::countNodes(incremental.module()) ==
+	       ast::countNodes(full.module());
+}
+
+// Checks in a child process, so that freeing the reference tree doesn't
+// slow down the next edit
+bool checkInChild(Context& context, const IncrementalParser& incremental,
+                  const std::string& text) {
+	fflush(stdout);
+
+	pid_t pid = fork();
+	if (pid < 0) {
+		perror("fork");
+		return false;
+	}
+
+	if (pid == 0)
+		_exit(check(context, incremental, text) ? 0 : 1);
+
+	int status;
+	waitpid(pid, &status, 0);
+
+	return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+void benchSize(size_t bytes) {
+	Config config;
+	SourceManager sources;
+	Diagnostics diag(config, sources);
+	Context context(config, diag, sources);
+
+	std::string source = generateSource(bytes);
+
+	IncrementalParser parser(context, "bench");
+
+	Clock::time_point start = Clock::now();
+	parser.parse(sources.addFile("bench.llang",
+		new SourceBuffer(source.data(), source.size())));
+	double fullTime = secondsSince(start);
+
+	// Somewhere in the middle of a function
+	size_t middle = source.find("a * b", source.size() / 2);
+	size_t next = source.find("fn ", middle);
+
+	// Offsets are in the text after the previous edits
+	Edit edits[] = {
+		{ middle + 5, 0, " + 1" }, // extend an expression
+		{ middle, 1, "alpha" }, // rename a use
+		{ next + 8, 0, "fn i32 g(i32 x) = x;\n" }, // add a declaration
+		{ next + 8, 21, "" }, // and remove it again
+		{ middle, 0, "// note\n" }, // add a comment
+		{ middle, 8, "" }
+	};
+
+	const size_t editCount = sizeof(edits) / sizeof(edits[0]);
+	double total = 0;
+
+	for (size_t i = 0; i < editCount; ++i) {
+		start = Clock::now();
+		parser.update(edits[i]);
+		total += secondsSince(start);
+
+		source.replace(edits[i].offset, edits[i].removed, edits[i].inserted);
+		if (!checkInChild(context, parser, source)) {
+			fprintf(stderr, "edit %zu: incremental result differs\n", i);
+			exit(1);
+		}
+	}
+
+	printf("%5zu MB: full parse %9.3f ms, edit %7.3f ms on average",
+	       bytes >> 20, fullTime * 1e3, total / editCount * 1e3);
+
+	// Type a word and delete it again, one character at a time, all over
+	// the file. Neither the time of an edit nor the memory or location
+	// space it takes should grow with the file or the session.
+	const size_t sessionEdits = 20000;
+	const char word[] = "beta";
+	size_t offset = middle;
+	total = 0;
+
+	for (size_t i = 0; i < sessionEdits; ++i) {
+		const size_t typed = i % 8;
+
+		if (typed == 0) {
+			offset = source.find("a * b", (offset + 4099) % source.size());
+			if (offset == std::string::npos)
+				offset = middle;
+		}
+
+		Edit edit = { offset + (typed < 4 ? typed : 7 - typed),
+		              typed < 4 ? 0u : 1u,
+		              typed < 4 ? std::string(1, word[typed]) : "" };
+		start = Clock::now();
+		parser.update(edit);
+		total += secondsSince(start);
+
+		source.replace(edit.offset, edit.removed, edit.inserted);
+	}
+
+	printf(", %zu typed %7.3f ms\n", sessionEdits,
+	       total / sessionEdits * 1e3);
+
+	if (!checkInChild(context, parser, source)) {
+		fprintf(stderr, "typing: incremental result differs\n");
+		exit(1);
+	}
+}
+
+} // namespace
+
+int main(int argc, const char** argv) {
+	size_t megabytes = argc > 1 ? strtoul(argv[1], 0, 10) : 16;
+
+	for (size_t size = 1; size <= megabytes; size *= 4)
+		benchSize(size << 20);
+}
@@ -0,0 +1,403 @@
+// Lexer microbenchmarks
+//
+// Build with "./build.py bench", run as "./lexer_bench [megabytes]".
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "common/config.hpp"
+#include "common/context.hpp"
+#include "common/diagnostics.hpp"
+#include "common/source_manager.hpp"
+#include "util/scan.hpp"
+#include "lexer/lexer.hpp"
+#include "lexer/token_stream.hpp"
+#include "lexer/parallel_lexer.hpp"
+
+using namespace llang;
+using namespace llang::lexer;
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+double secondsSince(Clock::time_point start) {
+	return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// Identifier-heavy source, roughly the shape of our generated modules
+std::string generateSource(size_t bytes) {
+	std::string source;
+	source.reserve(bytes + 256);
+
+	char line[256];
+	for (size_t i = 0; source.size() < bytes; ++i) {
+		snprintf(line, sizeof(line),
+			"fn i32 function_%zu(i32 alpha, i32 beta) = {\n"
+			"\tvar i32 gamma_%zu = alpha * beta + %zu; // comment\n"
+			"\tif (gamma_%zu = alpha) helper(gamma_%zu, beta) else beta;\n"
+			"};\n",
+			i, i, i, i, i);
+		source += line;
+
+		// Now and then a string literal spanning lines, which the parallel
+		// lexer has to resynchronize after
+		if (i % 64 == 0)
+			source += "var string text = \"first line\n// not a comment\n\";\n";
+	}
+
+	return source;
+}
+
+// The std::map lookup the lexer used before the keyword switch
+typedef std::map<std::string, Token::Type> keyword_map_t;
+
+keyword_map_t makeKeywordMap() {
+	keyword_map_t map;
+
+	map["fn"] = Token::KEYWORD_FN;
+	map["var"] = Token::KEYWORD_VAR;
+	map["if"] = Token::KEYWORD_IF;
+	map["else"] = Token::KEYWORD_ELSE;
+	map["i32"] = Token::KEYWORD_I32;
+	map["int"] = Token::KEYWORD_INT;
+	map["void"] = Token::KEYWORD_VOID;
+	map["string"] = Token::KEYWORD_STRING;
+	map["char"] = Token::KEYWORD_CHAR;
+	map["bool"] = Token::KEYWORD_BOOL;
+	map["true"] = Token::KEYWORD_TRUE;
+	map["false"] = Token::KEYWORD_FALSE;
+	map["extern"] = Token::KEYWORD_EXTERN;
+	map["arr"] = Token::KEYWORD_ARRAY;
+
+	return map;
+}
+
+struct Word {
+	const char* start;
+	size_t length;
+};
+
+std::vector<Word> collectWords(const std::string& source) {
+	std::vector<Word> words;
+
+	const char* c = source.c_str();
+	while (*c) {
+		if (isalpha(*c) || *c == '_') {
+			Word word = { c, 0 };
+			while (isalnum(*c) || *c == '_') ++c;
+			word.length = static_cast<size_t>(c - word.start);
+			words.push_back(word);
+		}
+		else ++c;
+	}
+
+	return words;
+}
+
+void benchKeywords(const std::string& source) {
+	std::vector<Word> words = collectWords(source);
+	const keyword_map_t keywords = makeKeywordMap();
+	size_t hits = 0;
+
+	Clock::time_point start = Clock::now();
+	for (size_t i = 0; i < words.size(); ++i) {
+		std::string identifier(words[i].start, words[i].length);
+		if (keywords.find(identifier) != keywords.end()) ++hits;
+	}
+	double mapTime = secondsSince(start);
+
+	start = Clock::now();
+	for (size_t i = 0; i < words.size(); ++i) {
+		Token::Type type;
+		if (isKeyword(words[i].start, words[i].length, type)) --hits;
+	}
+	double switchTime = secondsSince(start);
+
+	if (hits != 0) {
+		fprintf(stderr, "keyword lookups disagree\n");
+		exit(1);
+	}
+
+	printf("keywords/map:    %8.1f Mwords/s\n", static_cast<double>(words.size()) / mapTime / 1e6);
+	printf("keywords/switch: %8.1f Mwords/s (%.1fx)\n",
+	       static_cast<double>(words.size()) / switchTime / 1e6, mapTime / switchTime);
+}
+
+// The hand-written switch the lexer used before the DFA. Everything but the
+// dispatch works like in the real lexer.
+class SwitchLexer {
+public:
+	SwitchLexer(Context& context, SourceManager::FileId file)
+		: identifiers(context.identifiers),
+		  source(context.sources.buffer(file)),
+		  base(context.sources.location(file, 0)),
+		  c(source.begin()) {
+	}
+
+	// Not inlined into the benchmark loop, which Lexer::lexToken can't be
+	// either
+	__attribute__((noinline)) Token lexToken() {
+		for (;;) {
+			if (scan::is(*c, scan::WHITESPACE))
+				c = scan::skipWhitespace(c);
+			else if (*c == '/' && c[1] == '/')
+				c = scan::findLineEnd(c + 2);
+			else
+				break;
+		}
+
+		const Location location(base.offset +
+			static_cast<uint32_t>(c - source.begin()));
+
+		switch (*c) {
+		case '(': ++c; return Token(location, Token::LPAREN, 1);
+		case ')': ++c; return Token(location, Token::RPAREN, 1);
+		case '=': ++c; return Token(location, Token::EQUALS, 1);
+		case ';': ++c; return Token(location, Token::SEMICOLON, 1);
+		case ',': ++c; return Token(location, Token::COMMA, 1);
+		case '{': ++c; return Token(location, Token::LBRACE, 1);
+		case '}': ++c; return Token(location, Token::RBRACE, 1);
+		case '+': ++c; return Token(location, Token::PLUS, 1);
+		case '*': ++c; return Token(location, Token::STAR, 1);
+		case '-': ++c; return Token(location, Token::MINUS, 1);
+		case '/': ++c; return Token(location, Token::SLASH, 1);
+		case '[': ++c; return Token(location, Token::LBRACKET, 1);
+		case ']': ++c; return Token(location, Token::RBRACKET, 1);
+		case '"': {
+			const char* start = ++c;
+			while (*c != '"') c += *c == '\\' ? 2 : 1;
+			++c;
+			return Token(location, Token::STRING,
+			             static_cast<uint32_t>(c - start + 1));
+		}
+		case '\0':
+			return Token(location, Token::END_OF_FILE, 0);
+		default:
+			if (scan::is(*c, scan::IDENTIFIER_START)) {
+				const char* start = c;
+				c = scan::skipIdentifier(c + 1);
+
+				Token::Type type;
+				const size_t length = static_cast<size_t>(c - start);
+				if (isKeyword(start, length, type))
+					return Token(location, type, static_cast<uint32_t>(length));
+
+				return Token(location, Token::IDENTIFIER,
+				             static_cast<uint32_t>(length),
+				             identifiers.intern(start, length).id());
+			}
+			else if (scan::is(*c, scan::DIGIT)) {
+				const char* start = c;
+				int_t number = 0;
+				for (const char* end = scan::skipDigits(c); c != end; ++c)
+					number = number * 10 + (*c - '0');
+
+				return Token(location, Token::NUMBER,
+				             static_cast<uint32_t>(c - start),
+				             static_cast<uint32_t>(number));
+			}
+		}
+
+		abort();
+	}
+
+private:
+	Interner& identifiers;
+	const SourceBuffer& source;
+	const Location base;
+	const char* c;
+};
+
+// Lexes the whole source with a fresh Context, so that both lexers start
+// with an empty interner
+template <typename L>
+double timeLexer(const std::string& source, std::vector<Token::Type>& types) {
+	Config config;
+	SourceManager sources;
+	Diagnostics diag(config, sources);
+	Context context(config, diag, sources);
+
+	SourceManager::FileId file = sources.addFile("bench.llang",
+		new SourceBuffer(source.data(), source.size()));
+
+	types.clear();
+	L lexer(context, file);
+
+	Clock::time_point start = Clock::now();
+
+	for (;;) {
+		Token token = lexer.lexToken();
+		types.push_back(token.type);
+
+		if (token.type == Token::END_OF_FILE) break;
+	}
+
+	return secondsSince(start);
+}
+
+void benchDispatch(const std::string& source) {
+	std::vector<Token::Type> switchTypes, dfaTypes;
+	switchTypes.reserve(source.size() / 2);
+	dfaTypes.reserve(source.size() / 2);
+
+	// Alternating, best of a few runs each
+	double switchTime = 0, dfaTime = 0;
+
+	for (int run = 0; run < 9; ++run) {
+		double time = timeLexer<SwitchLexer>(source, switchTypes);
+		if (run == 0 || time < switchTime) switchTime = time;
+
+		time = timeLexer<Lexer>(source, dfaTypes);
+		if (run == 0 || time < dfaTime) dfaTime = time;
+	}
+
+	if (switchTypes != dfaTypes) {
+		fprintf(stderr, "switch and DFA lexers disagree\n");
+		exit(1);
+	}
+
+	printf("dispatch/switch: %8.1f MB/s\n", static_cast<double>(source.size()) / switchTime / 1e6);
+	printf("dispatch/dfa:    %8.1f MB/s (%.2fx)\n",
+	       static_cast<double>(source.size()) / dfaTime / 1e6, switchTime / dfaTime);
+}
+
+void benchLexer(const std::string& source) {
+	Config config;
+	SourceManager sources;
+	Diagnostics diag(config, sources);
+	Context context(config, diag, sources);
+
+	SourceManager::FileId file = sources.addFile("bench.llang",
+		new SourceBuffer(source.data(), source.size()));
+
+	Lexer lexer(context, file);
+	size_t tokens = 0;
+
+	Clock::time_point start = Clock::now();
+	while (lexer.lexToken().type != Token::END_OF_FILE) ++tokens;
+	double time = secondsSince(start);
+
+	printf("lexer            %8.1f MB/s, %.1f Mtokens/s\n",
+	       static_cast<double>(source.size()) / time / 1e6,
+	       static_cast<double>(tokens) / time / 1e6);
+
+	const char* begin = sources.buffer(file).begin();
+	const char* end = sources.buffer(file).end();
+
+	// Compare the line table kernels of every level the CPU supports
+	for (int level = scan::SCALAR; level <= scan::maxLevel(); ++level) {
+		scan::setLevel(static_cast<scan::Level>(level));
+
+		start = Clock::now();
+		size_t lines = scan::countNewlines(begin, end);
+		std::vector<uint32_t> newlines(lines);
+		scan::findNewlines(begin, end, &newlines[0]);
+		double lineTime = secondsSince(start);
+
+		printf("lines/%-6s      %8.1f MB/s\n", scan::levelName(scan::level()),
+		       static_cast<double>(source.size()) / lineTime / 1e6);
+	}
+}
+
+void benchTokenStream(const std::string& source) {
+	Config config;
+	SourceManager sources;
+	Diagnostics diag(config, sources);
+	Context context(config, diag, sources);
+
+	SourceManager::FileId file = sources.addFile("bench.llang",
+		new SourceBuffer(source.data(), source.size()));
+
+	const TokenStream::Mode modes[] =
+		{ TokenStream::STREAMING, TokenStream::PRELEXED };
+	const char* names[] = { "streaming", "prelexed" };
+
+	// Includes the lexing, like the parser sees it. Each step looks one
+	// token ahead.
+	for (size_t i = 0; i < 2; ++i) {
+		Clock::time_point start = Clock::now();
+
+		Lexer lexer(context, file);
+		TokenStream ts(lexer, modes[i]);
+
+		size_t tokens = 0, checksum = 0;
+		while (ts.get().type != Token::END_OF_FILE) {
+			checksum += ts.peek().type;
+			ts.next();
+			++tokens;
+		}
+
+		double time = secondsSince(start);
+
+		printf("stream/%-9s  %8.1f Mtokens/s (checksum %zu)\n", names[i],
+		       static_cast<double>(tokens) / time / 1e6, checksum);
+	}
+}
+
+void benchParallel(const std::string& source) {
+	std::vector<Token> expected;
+	double serialTime;
+
+	{
+		Config config;
+		SourceManager sources;
+		Diagnostics diag(config, sources);
+		Context context(config, diag, sources);
+
+		SourceManager::FileId file = sources.addFile("bench.llang",
+			new SourceBuffer(source.data(), source.size()));
+
+		Clock::time_point start = Clock::now();
+		ParallelLexer(context, file, 1).lexAll(expected);
+		serialTime = secondsSince(start);
+
+		printf("parallel/1       %8.1f MB/s\n", static_cast<double>(source.size()) / serialTime / 1e6);
+	}
+
+	unsigned cores = std::thread::hardware_concurrency();
+	for (unsigned threads = 2; threads <= std::max(2u, cores); threads *= 2) {
+		Config config;
+		SourceManager sources;
+		Diagnostics diag(config, sources);
+		Context context(config, diag, sources);
+
+		SourceManager::FileId file = sources.addFile("bench.llang",
+			new SourceBuffer(source.data(), source.size()));
+
+		std::vector<Token> tokens;
+
+		Clock::time_point start = Clock::now();
+		ParallelLexer(context, file, threads).lexAll(tokens);
+		double time = secondsSince(start);
+
+		if (tokens.size() != expected.size() ||
+		    memcmp(&tokens[0], &expected[0], tokens.size() * sizeof(Token))) {
+			fprintf(stderr, "parallel lexer disagrees with serial lexer\n");
+			exit(1);
+		}
+
+		printf("parallel/%-2u      %8.1f MB/s (%.2fx)\n", threads,
+		       static_cast<double>(source.size()) / time / 1e6, serialTime / time);
+	}
+}
+
+} // namespace
+
+int main(int argc, const char** argv) {
+	size_t megabytes = argc > 1 ? strtoul(argv[1], 0, 10) : 64;
+	std::string source = generateSource(megabytes << 20);
+
+	benchKeywords(source);
+	benchDispatch(source);
+	benchLexer(source);
+	benchTokenStream(source);
+	benchParallel(source);
+}
@@ -0,0 +1,330 @@
+// Throughput of the compiler phases on synthetic programs
+//
+// Build with "./build.py bench", run as
+// "./phase_bench [megabytes] [shape...]". Prints one JSON object per shape
+// and phase, e.g.
+//
+//   {"shape": "functions", "phase": "parser", "bytes": 1048628,
+//    "nodes": 264968, "seconds": 0.053696, "mb_per_s": 19.5,
+//    "nodes_per_s": 4934561.6, "peak_rss_kb": 40568}
+//
+// The lexer phase reports tokens instead of nodes.
+//
+// Every shape runs in its own process, so peak_rss_kb is the peak of that
+// shape up to the end of the phase.
+
+#include <chrono>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+#include "util/smart_ptr.hpp"
+#include "common/config.hpp"
+#include "common/context.hpp"
+#include "common/diagnostics.hpp"
+#include "common/source_manager.hpp"
+#include "lexer/lexer.hpp"
+#include "lexer/token_stream.hpp"
+#include "ast/decl.hpp"
+#include "ast/type.hpp"
+#include "ast/expr.hpp"
+#include "ast/node_count.hpp"
+#include "parser/parser.hpp"
+#include "semantic/phase1/visitors.hpp"
+#include "semantic/phase2/visitors.hpp"
+#include "codegen/llvm/codegen.hpp"
+
+using namespace llang;
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+double secondsSince(Clock::time_point start) {
+	return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+long peakRssKb() {
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	return usage.ru_maxrss; // kilobytes on Linux
+}
+
+void append(std::string& source, const char* format, ...)
+	__attribute__((format(printf, 2, 3)));
+
+void append(std::string& source, const char* format, ...) {
+	char buffer[1024];
+
+	va_list argp;
+	va_start(argp, format);
+	vsnprintf(buffer, sizeof(buffer), format, argp);
+	va_end(argp);
+
+	source += buffer;
+}
+
+// Many small top-level functions, each calling the previous one
+void generateFunctions(std::string& source, size_t bytes) {
+	source += "fn i32 f_0(i32 a, i32 b) = a;\n";
+
+	for (size_t i = 1; source.size() < bytes; ++i) {
+		append(source,
+			"fn i32 f_%zu(i32 a, i32 b) = {\n"
+			"\tvar i32 c = a * b + %zu;\n"
+			"\tif (c = a) f_%zu(c, b) else b;\n"
+			"};\n",
+			i, i, i - 1);
+	}
+}
+
+// Functions nested 32 deep, the innermost one using all outer parameters
+void generateNested(std::string& source, size_t bytes) {
+	const size_t depth = 32;
+
+	for (size_t i = 0; source.size() < bytes; ++i) {
+		append(source, "fn i32 outer_%zu(i32 p0) = {\n", i);
+
+		for (size_t d = 1; d < depth; ++d)
+			append(source, "fn i32 n_%zu(i32 p%zu) = {\n", d, d);
+
+		source += "p0";
+		for (size_t d = 1; d < depth; ++d)
+			append(source, " + p%zu", d);
+		source += ";\n";
+
+		for (size_t d = depth - 1; d > 0; --d)
+			append(source, "};\nn_%zu(p%zu);\n", d, d - 1);
+
+		source += "};\n";
+	}
+}
+
+// Functions whose bodies are blocks of 1000 expressions
+void generateBlocks(std::string& source, size_t bytes) {
+	const size_t length = 1000;
+
+	for (size_t i = 0; source.size() < bytes; ++i) {
+		append(source, "fn i32 block_%zu(i32 a) = {\n\tvar i32 v0 = a;\n", i);
+
+		for (size_t j = 1; j < length; ++j)
+			append(source, "\tvar i32 v%zu = v%zu + %zu;\n", j, j - 1, j);
+
+		append(source, "\tv%zu;\n};\n", length - 1);
+	}
+}
+
+// String literals of 64 KB, some with escape sequences
+void generateStrings(std::string& source, size_t bytes) {
+	const size_t length = 64 * 1024;
+
+	source += "fn void take(string s) = void;\n";
+
+	std::string text;
+	for (size_t i = 0; text.size() < length; ++i)
+		text += i % 16 == 0 ? "line\\n" : "lorem ipsum ";
+
+	for (size_t i = 0; source.size() < bytes; ++i) {
+		append(source, "fn void s_%zu() = take(\"", i);
+
+		// Every other literal has no escapes and needs no decoding
+		if (i % 2)
+			source += text;
+		else
+			source.append(length, 'x');
+
+		source += "\");\n";
+	}
+}
+
+// Calls nested 100 deep
+void generateCalls(std::string& source, size_t bytes) {
+	const size_t depth = 100;
+
+	source += "fn i32 step(i32 x) = x + 1;\n";
+
+	for (size_t i = 0; source.size() < bytes; ++i) {
+		append(source, "fn i32 chain_%zu(i32 x) = ", i);
+
+		for (size_t d = 0; d < depth; ++d)
+			source += "step(";
+		source += "x";
+		source.append(depth, ')');
+
+		source += ";\n";
+	}
+}
+
+struct Shape {
+	const char* name;
+	void (*generate)(std::string&, size_t);
+};
+
+const Shape shapes[] = {
+	{ "functions", generateFunctions },
+	{ "nested", generateNested },
+	{ "blocks", generateBlocks },
+	{ "strings", generateStrings },
+	{ "calls", generateCalls }
+};
+
+const size_t shapeCount = sizeof(shapes) / sizeof(shapes[0]);
+
+void report(FILE* out, const char* shape, const char* phase, size_t bytes,
+            const char* unit, size_t count, double seconds) {
+	fprintf(out,
+		"{\"shape\": \"%s\", \"phase\": \"%s\", \"bytes\": %zu, "
+		"\"%s\": %zu, \"seconds\": %.6f, \"mb_per_s\": %.1f, "
+		"\"%s_per_s\": %.1f, \"peak_rss_kb\": %ld}\n",
+		shape, phase, bytes, unit, count, seconds,
+		static_cast<double>(bytes) / seconds / 1e6,
+		unit, static_cast<double>(count) / seconds, peakRssKb());
+	fflush(out);
+}
+
+// For strings that may contain anything, like error messages
+std::string jsonEscaped(const char* string) {
+	std::string result;
+
+	for (; *string; ++string) {
+		const char c = *string;
+
+		if (c == '"' || c == '\\') {
+			result += '\\';
+			result += c;
+		} else if (static_cast<unsigned char>(c) < 0x20) {
+			char buffer[8];
+			snprintf(buffer, sizeof(buffer), "\\u%04x", c);
+			result += buffer;
+		} else {
+			result += c;
+		}
+	}
+
+	return result;
+}
+
+void runShape(FILE* out, const Shape& shape, size_t bytes) {
+	std::string source;
+	source.reserve(bytes + 128 * 1024);
+	shape.generate(source, bytes);
+
+	Config config;
+	SourceManager sources;
+	Diagnostics diag(config, sources);
+	Context context(config, diag, sources);
+
+	SourceManager::FileId file = sources.addFile(shape.name,
+		new SourceBuffer(source.data(), source.size()));
+	bytes = source.size();
+	std::string().swap(source);
+
+	lexer::Lexer lexer(context, file);
+	std::vector<lexer::Token> tokens;
+	tokens.reserve(bytes / 4 + 1);
+
+	Clock::time_point start = Clock::now();
+	do tokens.push_back(lexer.lexToken());
+	while (tokens.back().type != lexer::Token::END_OF_FILE);
+	report(out, shape.name, "lexer", bytes, "tokens", tokens.size(),
+	       secondsSince(start));
+
+	lexer::TokenStream ts(lexer, tokens);
+	parser::Parser parser(context, shape.name, ts);
+
+	start = Clock::now();
+	scoped_ptr<ast::Module> module(parser.parseModule());
+	double time = secondsSince(start);
+
+	ast::DeclPtr root = module.get();
+	size_t nodes = ast::countNodes(root);
+	report(out, shape.name, "parser", bytes, "nodes", nodes, time);
+
+	scoped_ptr<semantic::Visitors>
+		phase1(semantic::makePhase1Visitors(context)),
+		phase2(semantic::makePhase2Visitors(context));
+	semantic::ScopeState state;
+
+	start = Clock::now();
+	root = phase1->declVisitor->accept(root, state);
+	report(out, shape.name, "phase1", bytes, "nodes", nodes,
+	       secondsSince(start));
+
+	start = Clock::now();
+	root = phase2->declVisitor->accept(root, state);
+	report(out, shape.name, "phase2", bytes, "nodes", nodes,
+	       secondsSince(start));
+
+	codegen::Codegen gen(context, ast::assumeIsA<ast::Module>(root));
+
+	start = Clock::now();
+	gen.run();
+	report(out, shape.name, "codegen", bytes, "nodes", nodes,
+	       secondsSince(start));
+}
+
+// Runs the shape in a child process. The compiler's own output (the module
+// dump) goes to /dev/null, the report to stdout.
+bool runShapeInChild(const Shape& shape, size_t bytes) {
+	fflush(stdout);
+
+	pid_t pid = fork();
+	if (pid < 0) {
+		perror("fork");
+		return false;
+	}
+
+	if (pid == 0) {
+		FILE* out = fdopen(dup(STDOUT_FILENO), "w");
+
+		int null = open("/dev/null", O_WRONLY);
+		dup2(null, STDOUT_FILENO);
+		dup2(null, STDERR_FILENO);
+
+		try {
+			runShape(out, shape, bytes);
+		} catch (const std::exception& e) {
+			// The diagnostic itself went to /dev/null, but the exception
+			// carries it
+			fprintf(out, "{\"shape\": \"%s\", \"error\": \"%s\"}\n",
+			        shape.name, jsonEscaped(e.what()).c_str());
+			_exit(1);
+		}
+
+		fflush(out);
+		_exit(0);
+	}
+
+	int status;
+	waitpid(pid, &status, 0);
+
+	return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+} // namespace
+
+int main(int argc, const char** argv) {
+	size_t megabytes = argc > 1 ? strtoul(argv[1], 0, 10) : 16;
+
+	bool ok = true;
+
+	for (size_t i = 0; i < shapeCount; ++i) {
+		bool selected = argc <= 2;
+		for (int j = 2; j < argc; ++j)
+			selected |= strcmp(argv[j], shapes[i].name) == 0;
+
+		if (selected)
+			ok &= runShapeInChild(shapes[i], megabytes << 20);
+	}
+
+	return ok ? 0 : 1;
+}
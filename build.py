@@ -2,21 +2,42 @@
 
 from fabricate import *
 
-setup(dirs=['.', 'compiler', '.obj'])
+setup(dirs=['.', 'compiler', 'bench', '.obj'])
 
 sources = ['parser/parser',
+           'parser/incremental_parser',
+           'parser/parallel_parser',
            'common/diagnostics',
+           'common/source_buffer',
+           'common/interner',
+           'common/literal_pool',
+           'common/source_manager',
+           'common/piece_table',
+           'common/trace',
+           'common/trace_events',
+           'util/scan',
            'main',
            'semantic/scope',
+           'semantic/symbol_table',
            'lexer/token',
            'lexer/lexer',
+           'lexer/parallel_lexer',
            'semantic/phase1/visitors',
            'semantic/phase2/visitors',
+           'semantic/body_queue',
            'codegen/llvm/codegen',
-           'ast/type']
+           'ast/type',
+           'ast/type_context',
+           'ast/arena',
+           'ast/node_count',
+           'cache/module_cache',
+           'driver/pass_manager']
 
-cflags = '-Icompiler -Wall -g -pedantic -Wextra -Wformat -Wconversion -std=c++0x'.split()
-lflags = '-L/usr/lib/llvm -lstdc++ -lLLVM-2.7'.split()
+# Benchmarks link against everything except the driver
+benchmarks = ['lexer_bench', 'phase_bench', 'incremental_bench']
+
+cflags = '-Icompiler -Wall -g -pedantic -Wextra -Wformat -Wconversion -std=c++0x -pthread'.split()
+lflags = '-L/usr/lib/llvm -lstdc++ -lLLVM-2.7 -pthread'.split()
 
 def path_to_object_file(path):
 	return '.obj/' + path.replace('/', '_') + '.o'
@@ -25,7 +46,17 @@ def build():
     compile()
     link()
 
+# Optimized, without asserts and trace points (see common/trace.hpp)
+def release():
+    cflags.extend(['-O2', '-DNDEBUG'])
+    build()
+
+def generate():
+    run('python', 'compiler/lexer/gen_dfa.py', 'compiler/lexer/tokens.spec',
+        'compiler/lexer/dfa.inc')
+
 def compile():
+    generate()
     for source in sources:
         run('gcc', '-c', 'compiler/'+source+'.cpp', '-o', path_to_object_file(source), cflags)
 
@@ -33,6 +64,17 @@ def link():
     objects = [path_to_object_file(s) for s in sources]
     run('gcc', '-o', 'llc', objects, lflags)
 
+def bench():
+    compile()
+    for benchmark in benchmarks:
+        run('gcc', '-c', 'bench/'+benchmark+'.cpp',
+            '-o', path_to_object_file('bench/'+benchmark), cflags)
+
+    objects = [path_to_object_file(s) for s in sources if s != 'main']
+    for benchmark in benchmarks:
+        run('gcc', '-o', benchmark, path_to_object_file('bench/'+benchmark),
+            objects, lflags)
+
 def clean():
     autoclean()
 
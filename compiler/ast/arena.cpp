@@ -0,0 +1,74 @@
+#include <cassert>
+#include <cstdint>
+
+#include "ast/arena.hpp"
+
+namespace llang {
+namespace ast {
+
+Arena::Arena()
+	: next(0), end(0), allocated(0) {
+}
+
+namespace {
+
+template <typename T> void runInReverse(const std::vector<T>& destructors) {
+	for (size_t i = destructors.size(); i > 0; --i)
+		destructors[i - 1].function(destructors[i - 1].object);
+}
+
+} // namespace
+
+Arena::~Arena() {
+	runInReverse(destructors);
+
+	for (size_t i = adopted.size(); i > 0; --i)
+		runInReverse(adopted[i - 1]);
+
+	for (size_t i = 0; i < blocks.size(); ++i)
+		delete[] blocks[i];
+}
+
+void Arena::adopt(Arena& other) {
+	// Keep allocating from our last block, other's are full enough
+	blocks.insert(blocks.begin(), other.blocks.begin(), other.blocks.end());
+	allocated += other.allocated;
+
+	adopted.push_back(std::vector<Destructor>());
+	adopted.back().swap(other.destructors);
+	adopted.insert(adopted.end(), other.adopted.begin(), other.adopted.end());
+
+	other.blocks.clear();
+	other.adopted.clear();
+	other.next = other.end = 0;
+	other.allocated = 0;
+}
+
+void* Arena::allocate(size_t size, size_t alignment) {
+	assert(alignment && (alignment & (alignment - 1)) == 0);
+	allocated += size;
+
+	const uintptr_t mask = alignment - 1;
+	char* start = reinterpret_cast<char*>(
+		(reinterpret_cast<uintptr_t>(next) + mask) & ~mask);
+
+	if (next && start <= end && static_cast<size_t>(end - start) >= size) {
+		next = start + size;
+		return start;
+	}
+
+	// Big objects get a block of their own, the current one stays in use
+	if (size > blockSize / 4) {
+		blocks.push_back(new char[size]);
+		return blocks.back();
+	}
+
+	blocks.push_back(new char[blockSize]);
+	next = blocks.back() + size;
+	end = blocks.back() + blockSize;
+
+	return blocks.back();
+}
+
+} // namespace ast
+} // namespace llang
@@ -0,0 +1,93 @@
+#ifndef LLANG_AST_ARENA_HPP_INCLUDED
+#define LLANG_AST_ARENA_HPP_INCLUDED
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace llang {
+namespace ast {
+
+// Owns the nodes of a module. Memory is handed out from large blocks by
+// bumping a pointer and released all at once when the arena is destroyed,
+// after running the destructors of the objects that need it (in reverse
+// order of construction).
+//
+// An object needs its destructor run if it isn't trivially destructible,
+// the others are just dropped with their block. Node classes also say
+// themselves whether they own anything (Node::ownsResources); make checks
+// that a node with such members doesn't forget to.
+class Arena {
+public:
+	Arena();
+	~Arena();
+
+	template <typename T, typename... Args> T* make(Args&&... args) {
+		static_assert(needsDestructor<T>(0) ||
+		              std::is_trivially_destructible<T>::value,
+		              "node has members to destroy but no ownsResources");
+
+		T* object = new (allocate(sizeof(T), alignof(T)))
+			T(std::forward<Args>(args)...);
+
+		if (needsDestructor<T>(0))
+			destructors.push_back(Destructor(object, &destroy<T>));
+
+		return object;
+	}
+
+	// Returns uninitialized memory, alignment must be a power of two no
+	// bigger than that of any fundamental type
+	void* allocate(size_t size, size_t alignment);
+
+	// Takes over other's memory and objects, leaving it empty
+	void adopt(Arena& other);
+
+	// Bytes handed out so far
+	size_t size() const { return allocated; }
+
+private:
+	Arena(const Arena&);
+	Arena& operator=(const Arena&);
+
+	struct Destructor {
+		Destructor(void* object, void (*function)(void*))
+			: object(object), function(function) {
+		}
+
+		void* object;
+		void (*function)(void*);
+	};
+
+	template <typename T>
+	static constexpr bool needsDestructor(decltype(T::ownsResources)*) {
+		return T::ownsResources;
+	}
+
+	template <typename T> static constexpr bool needsDestructor(...) {
+		return !std::is_trivially_destructible<T>::value;
+	}
+
+	template <typename T> static void destroy(void* object) {
+		static_cast<T*>(object)->~T();
+	}
+
+	static const size_t blockSize = 64 * 1024;
+
+	std::vector<char*> blocks;
+	char* next; // free space in the last block
+	char* end;
+	size_t allocated;
+
+	std::vector<Destructor> destructors;
+
+	// Taken over from other arenas, run after ours
+	std::vector<std::vector<Destructor> > adopted;
+};
+
+} // namespace ast
+} // namespace llang
+
+#endif
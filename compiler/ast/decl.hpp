@@ -2,10 +2,15 @@
 #define LLANG_AST_DECL_HPP_INCLUDED
 
 #include <list>
+#include <utility>
 
 #include "util/smart_ptr.hpp"
+#include "util/small_vector.hpp"
+#include "common/interner.hpp"
 
 #include "ast/node.hpp"
+#include "ast/arena.hpp"
+#include "ast/type_context.hpp"
 #include "ast/type_ptr.hpp"
 #include "ast/decl_ptr.hpp"
 #include "ast/expr_ptr.hpp"
@@ -37,10 +42,12 @@ public:
 	}
 };
 
-typedef shared_ptr<DelayedDecl> DelayedDeclPtr;
+typedef DelayedDecl* DelayedDeclPtr;
 
 class ScopedDecl : public Decl {
 public:
+	static const bool ownsResources = true;
+
 	shared_ptr<semantic::Scope> scope;
 
 protected:
@@ -50,21 +57,37 @@ protected:
 	}
 };
 
-typedef shared_ptr<ScopedDecl> ScopedDeclPtr;
+typedef ScopedDecl* ScopedDeclPtr;
+
+// Parses the function bodies the parser skipped (see
+// Config::lazyFunctionBodies)
+class BodySource {
+public:
+	virtual ~BodySource() {}
+
+	// Tokens [begin, end) of the module are a function's body
+	virtual ExprPtr parseBody(size_t begin, size_t end) = 0;
+};
 
+// The root of the tree. Unlike all other nodes it is allocated on the heap,
+// and owns the arena the rest of the tree lives in.
 class Module : public ScopedDecl {
 public:
-	typedef std::list<DeclPtr> DeclList;
+	typedef SmallVector<DeclPtr, 0> DeclList;
 
-	Module(const Location& location, const identifier_t& name, DeclList& decls)
-		: ScopedDecl(Node::MODULE, location, name),
-		  decls(decls) {
+	Module(const Location& location, const identifier_t& name)
+		: ScopedDecl(Node::MODULE, location, name), types(arena) {
 	}
 
+	Arena arena;
+	TypeContext types; // of the analyzed module
 	DeclList decls;
+
+	// Null if no bodies were skipped
+	scoped_ptr<BodySource> bodySource;
 };
 
-typedef shared_ptr<Module> ModulePtr;
+typedef Module* ModulePtr;
 
 class FunctionDecl;
 class VariableDecl : public Decl {
@@ -76,17 +99,18 @@ public:
 	             Node::Tag tag = Node::VARIABLE_DECL)
 		: Decl(tag, location, name),
 		  type(type),
-		  initializer(initializer) {
+		  initializer(initializer),
+		  function(0) {
 	}
 
 	TypePtr type;
 	ExprPtr initializer;
 
 	// Null if not declared in a function
-	shared_ptr<FunctionDecl> function;
+	FunctionDecl* function;
 };
 
-typedef shared_ptr<VariableDecl> VariableDeclPtr;
+typedef VariableDecl* VariableDeclPtr;
 
 class ParameterDecl : public VariableDecl {
 public:
@@ -101,36 +125,56 @@ public:
 	bool hasName;
 };
 
-typedef shared_ptr<ParameterDecl> ParameterDeclPtr;
+typedef ParameterDecl* ParameterDeclPtr;
 
 class FunctionDecl : public ScopedDecl {
 public:
-	typedef std::list<ParameterDeclPtr> ParameterList;
+	typedef SmallVector<ParameterDeclPtr, 4> ParameterList;
 
 	FunctionDecl(const Location& location,
 	             const identifier_t& name,
 	             TypePtr returnType,
-	             ParameterList& parameters,
+	             ParameterList&& parameters,
 	             ExprPtr body)
 		: ScopedDecl(Node::FUNCTION_DECL, location, name),
 		  returnType(returnType),
-		  parameters(parameters),
+		  parameters(std::move(parameters)),
 		  body(body),
+		  bodySource(0),
+		  bodyBegin(0),
+		  bodyEnd(0),
+		  type(0),
 		  isExtern(false),
-		  isNested(false) {
+		  isNested(false),
+		  parentFunction(0) {
 	}
 
-	std::string mangle() {
+	std::string mangle(const Interner& identifiers) {
 		// TODO
 		if (isNested)
-			return parentFunction->mangle() + '_' + name;
+			return parentFunction->mangle(identifiers) + '_' +
+			       identifiers.str(name);
 
-		return name;	
+		return identifiers.str(name);
 	}
 
+	// Parses the body if the parser skipped it
+	void loadBody() {
+		if (!bodySource) return;
+
+		body = bodySource->parseBody(bodyBegin, bodyEnd);
+		bodySource = 0;
+	}
+
+	bool isBodySkipped() const { return bodySource != 0; }
+
 	TypePtr returnType;
 	ParameterList parameters;
 	ExprPtr body;	
+
+	// Set if the parser skipped the body, which is null until loadBody
+	BodySource* bodySource;
+	size_t bodyBegin, bodyEnd; // token indices
 	
 	TypePtr type;
 
@@ -141,10 +185,10 @@ public:
 	std::list<VariableDeclPtr> outerVariables;
 
 	bool isNested;
-	shared_ptr<FunctionDecl> parentFunction;
+	FunctionDecl* parentFunction;
 };
 
-typedef shared_ptr<FunctionDecl> FunctionDeclPtr;
+typedef FunctionDecl* FunctionDeclPtr;
 
 } // namespace ast
 } // namespace llang
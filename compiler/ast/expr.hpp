@@ -1,12 +1,14 @@
 #ifndef LLANG_AST_EXPR_HPP_INCLUDED
 #define LLANG_AST_EXPR_HPP_INCLUDED
 
-#include <list>
+#include <utility>
 #include <cassert>
-#include <iostream>
 
 #include "util/smart_ptr.hpp"
+#include "util/small_vector.hpp"
 #include "common/number.hpp"
+#include "common/trace.hpp"
+#include "common/literal_pool.hpp"
 #include "ast/node.hpp"
 #include "ast/type_ptr.hpp"
 #include "ast/decl_ptr.hpp"
@@ -22,7 +24,7 @@ public:
 
 protected:
 	Expr(const Node::Tag tag, const Location& location)
-		: Node(tag, location) {
+		: Node(tag, location), type(0) {
 	}
 
 	Expr(const Node::Tag tag, const Location& location, TypePtr type)
@@ -41,7 +43,7 @@ public:
 	DeclPtr delayedDecl;		
 };
 
-typedef shared_ptr<DelayedExpr> DelayedExprPtr;
+typedef DelayedExpr* DelayedExprPtr;
 
 // Used internally
 class ImplicitCastExpr : public Expr {
@@ -54,7 +56,7 @@ public:
 	ExprPtr expr;
 };
 
-typedef shared_ptr<ImplicitCastExpr> ImplicitCastExprPtr;
+typedef ImplicitCastExpr* ImplicitCastExprPtr;
 
 class BinaryExpr : public Expr {
 public:
@@ -77,7 +79,7 @@ public:
 	ExprPtr left, right;
 };
 
-typedef shared_ptr<BinaryExpr> BinaryExprPtr;
+typedef BinaryExpr* BinaryExprPtr;
 
 class LiteralNumberExpr : public Expr {
 public:
@@ -89,19 +91,19 @@ public:
 	int_t number;
 };
 
-typedef shared_ptr<LiteralNumberExpr> LiteralNumberExprPtr;
+typedef LiteralNumberExpr* LiteralNumberExprPtr;
 
 class LiteralStringExpr : public Expr {
 public:
-	LiteralStringExpr(const Location& location, const std::string& string)
+	LiteralStringExpr(const Location& location, const StringLiteral& literal)
 		: Expr(Node::LITERAL_STRING_EXPR, location),
-		  string(string) {
+		  literal(literal) {
 	}
 
-	std::string string;
+	StringLiteral literal; // owned by the source buffer or the literal pool
 };
 
-typedef shared_ptr<LiteralStringExpr> LiteralStringExprPtr;
+typedef LiteralStringExpr* LiteralStringExprPtr;
 
 class LiteralBoolExpr : public Expr {
 public:
@@ -113,20 +115,22 @@ public:
 	bool value;
 };
 
-typedef shared_ptr<LiteralBoolExpr> LiteralBoolExprPtr;
+typedef LiteralBoolExpr* LiteralBoolExprPtr;
 
 class BlockExpr : public Expr {
 public:
-	typedef std::list<ExprPtr> ExprList;
+	static const bool ownsResources = true;
 
-	BlockExpr(const Location& location, ExprList& exprs)
+	typedef SmallVector<ExprPtr, 4> ExprList;
+
+	BlockExpr(const Location& location, ExprList&& exprs)
 		: Expr(Node::BLOCK_EXPR, location),
-	      exprs(exprs) {
-		std::cout << "x" << std::endl;
+		  exprs(std::move(exprs)) {
+		LLANG_TRACE(PARSE, "new BlockExpr of %zu exprs", this->exprs.size());
 	}
 
 	~BlockExpr() {
-		std::cout << "y" << std::endl;
+		LLANG_TRACE(PARSE, "delete BlockExpr");
 	}
 
 	ExprList exprs;
@@ -134,7 +138,7 @@ public:
 	shared_ptr<semantic::Scope> scope;
 };
 
-typedef shared_ptr<BlockExpr> BlockExprPtr;
+typedef BlockExpr* BlockExprPtr;
 
 class IfElseExpr : public Expr {
 public:
@@ -151,7 +155,7 @@ public:
 	ExprPtr elseExpr;
 };
 
-typedef shared_ptr<IfElseExpr> IfElseExprPtr;
+typedef IfElseExpr* IfElseExprPtr;
 
 class VoidExpr : public Expr {
 public:
@@ -160,7 +164,7 @@ public:
 	}
 };
 
-typedef shared_ptr<VoidExpr> VoidExprPtr;
+typedef VoidExpr* VoidExprPtr;
 
 class IdentifierExpr : public Expr {
 public:
@@ -172,7 +176,7 @@ public:
 	const identifier_t name;
 };
 
-typedef shared_ptr<IdentifierExpr> IdentifierExprPtr;
+typedef IdentifierExpr* IdentifierExprPtr;
 
 class DeclRefExpr : public Expr {
 public:
@@ -182,41 +186,41 @@ public:
 		Expr::type = type;
 	}
 
-	weak_ptr<Decl> decl;
+	DeclPtr decl;
 };
 
-typedef shared_ptr<DeclRefExpr> DeclRefExprPtr;
+typedef DeclRefExpr* DeclRefExprPtr;
 
 class CallExpr : public Expr {
 public:
-	typedef std::list<ExprPtr> ArgumentList;
+	static const bool ownsResources = true;
+
+	typedef SmallVector<ExprPtr, 4> ArgumentList;
 
 	CallExpr(const Location& location, ExprPtr callee,
-	         ArgumentList arguments)
+	         ArgumentList&& arguments)
 		: Expr(Node::CALL_EXPR, location),
-		  callee(callee), arguments(arguments) {
+		  callee(callee), arguments(std::move(arguments)) {
 	}
 
 	ExprPtr callee;
 	ArgumentList arguments;
 };
 
-typedef shared_ptr<CallExpr> CallExprPtr;
+typedef CallExpr* CallExprPtr;
 
 class DeclExpr : public Expr {
 public:
 	DeclExpr(const Location& location, DeclPtr decl)
 		: Expr(Node::DECL_EXPR, location),
 		  decl(decl) {
-		std::cout << "a" << std::endl;
+		LLANG_TRACE(PARSE, "new DeclExpr");
 	}
 
-	~DeclExpr() { std::cout << "b" << std::endl; }
-
 	DeclPtr decl;
 };
 
-typedef shared_ptr<DeclExpr> DeclExprPtr;
+typedef DeclExpr* DeclExprPtr;
 
 class ArrayElementExpr : public Expr {
 public:
@@ -229,7 +233,7 @@ public:
 	ExprPtr index;
 };
 
-typedef shared_ptr<ArrayElementExpr> ArrayElementExprPtr;
+typedef ArrayElementExpr* ArrayElementExprPtr;
 
 } // namespace ast
 } // namespace llang
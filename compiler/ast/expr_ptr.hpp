@@ -1,13 +1,11 @@
 #ifndef LLANG_AST_EXPR_PTR_HPP_INCLUDED
 #define LLANG_AST_EXPR_PTR_HPP_INCLUDED
 
-#include "util/smart_ptr.hpp"
-
 namespace llang {
 namespace ast {
 
 class Expr;
-typedef shared_ptr<Expr> ExprPtr;
+typedef Expr* ExprPtr;
 
 } // namespace ast
 } // namespace llang
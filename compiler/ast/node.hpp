@@ -1,34 +1,53 @@
 #ifndef LLANG_AST_NODE_HPP_INCLUDED
 #define LLANG_AST_NODE_HPP_INCLUDED
 
-#include "util/smart_ptr.hpp"
+#include <cassert>
+
 #include "common/location.hpp"
 #include "ast/node_table.hpp"
 
 namespace llang {
 namespace ast {
 
+class Node;
+
+// Whether the node is a T, decided by its tag (LLVM's classof). Specialized
+// below for every node class.
+template <typename T> bool classof(const Node* node);
+
 class Node {
 public:
 #define GENERATE_ENUM_ENTRY(name, nameInCaps) nameInCaps,
+#define COUNT_ENTRY(name, nameInCaps) + 1
 	enum Tag {
 		LLANG_AST_NODE_TABLE(GENERATE_ENUM_ENTRY)
-		TYPE_MAX
+		TYPE_MAX,
+
+		FIRST_DECL = 0,
+		LAST_DECL = FIRST_DECL LLANG_AST_DECL_TABLE(COUNT_ENTRY) - 1,
+		FIRST_TYPE = LAST_DECL + 1,
+		LAST_TYPE = FIRST_TYPE LLANG_AST_TYPE_TABLE(COUNT_ENTRY) - 1,
+		FIRST_EXPR = LAST_TYPE + 1,
+		LAST_EXPR = FIRST_EXPR LLANG_AST_EXPR_TABLE(COUNT_ENTRY) - 1
 	};
+#undef COUNT_ENTRY
 #undef GENERATE_ENUM_ENTRY
 
 	Node(Tag tag, const Location& location)
 		: tag(tag), location_(location) {
 	}
 
-	virtual ~Node() {}
+	// Whether the arena has to run the destructor (see Arena). Classes with
+	// members that can hold memory of their own, like child lists or
+	// scopes, set it.
+	static const bool ownsResources = false;
 
 	template <typename T> T* isA() {
-		return dynamic_cast<T*>(this);
+		return classof<T>(this) ? static_cast<T*>(this) : 0;
 	}
 
 	template <typename T> const T* isA() const {
-		return dynamic_cast<const T*>(this);
+		return classof<T>(this) ? static_cast<const T*>(this) : 0;
 	}
 
 	const Tag tag;
@@ -37,23 +56,98 @@ public:
 		return location_;
 	}
 
+protected:
+	// Not virtual: the arena destroys nodes as their own class, so nodes
+	// without members of their own are trivially destructible
+	~Node() = default;
+
 private:
 	const Location location_;
 };
 
-typedef shared_ptr<Node> NodePtr;
+typedef Node* NodePtr;
+
+#define DECLARE_CLASS(name, nameInCaps) class name;
+LLANG_AST_NODE_TABLE(DECLARE_CLASS)
+#undef DECLARE_CLASS
 
-template <typename T, typename U> shared_ptr<T> isA(shared_ptr<U> p) {
-	return dynamic_pointer_cast<T>(p);
+class Decl;
+class ScopedDecl;
+class Type;
+class Expr;
+
+inline bool tagIn(Node::Tag tag, Node::Tag first, Node::Tag last) {
+	return tag >= first && tag <= last;
+}
+
+template <> inline bool classof<Node>(const Node*) {
+	return true;
 }
 
-template <typename T, typename U> shared_ptr<T> assumeIsA(shared_ptr<U> p) {
-	shared_ptr<T> t = isA<T>(p);
-	assert(t.get());
+template <> inline bool classof<Decl>(const Node* node) {
+	return tagIn(node->tag, Node::FIRST_DECL, Node::LAST_DECL);
+}
+
+// Declarations are written out, as VariableDecl has a subclass
+
+template <> inline bool classof<ScopedDecl>(const Node* node) {
+	return tagIn(node->tag, Node::MODULE, Node::FUNCTION_DECL);
+}
+
+template <> inline bool classof<Module>(const Node* node) {
+	return node->tag == Node::MODULE;
+}
+
+template <> inline bool classof<FunctionDecl>(const Node* node) {
+	return node->tag == Node::FUNCTION_DECL;
+}
+
+template <> inline bool classof<VariableDecl>(const Node* node) {
+	return tagIn(node->tag, Node::VARIABLE_DECL, Node::PARAMETER_DECL);
+}
+
+template <> inline bool classof<ParameterDecl>(const Node* node) {
+	return node->tag == Node::PARAMETER_DECL;
+}
+
+template <> inline bool classof<DelayedDecl>(const Node* node) {
+	return node->tag == Node::DELAYED_DECL;
+}
+
+template <> inline bool classof<Type>(const Node* node) {
+	return tagIn(node->tag, Node::FIRST_TYPE, Node::LAST_TYPE);
+}
+
+template <> inline bool classof<Expr>(const Node* node) {
+	return tagIn(node->tag, Node::FIRST_EXPR, Node::LAST_EXPR);
+}
+
+#define GENERATE_CLASSOF(name, nameInCaps) \
+	template <> inline bool classof<name>(const Node* node) { \
+		return node->tag == Node::nameInCaps; \
+	}
+LLANG_AST_TYPE_TABLE(GENERATE_CLASSOF)
+LLANG_AST_EXPR_TABLE(GENERATE_CLASSOF)
+#undef GENERATE_CLASSOF
+
+// Null if p is null or not a T
+template <typename T, typename U> T* isA(U* p) {
+	return p && classof<T>(p) ? static_cast<T*>(p) : 0;
+}
+
+template <typename T, typename U> T* assumeIsA(U* p) {
+	T* t = isA<T>(p);
+	assert(t);
 
 	return t;
 }
 
+// For when the tag says what the node is. Being a template, it also works
+// where T is only declared.
+template <typename T, typename U> T* nodeCast(U* p) {
+	return static_cast<T*>(p);
+}
+
 } // namespace semantic
 } // namespace llang
 
@@ -0,0 +1,120 @@
+#include "common/source_manager.hpp"
+#include "ast/node_count.hpp"
+#include "ast/decl.hpp"
+#include "ast/expr.hpp"
+#include "ast/type.hpp"
+#include "ast/visitor.hpp"
+
+namespace llang {
+namespace ast {
+
+namespace {
+
+class NodeCounter : public Visitor<void, size_t> {
+public:
+	size_t count(NodePtr node) {
+		return node ? accept(node) : 0;
+	}
+
+	template <typename T> size_t count(T begin, T end) {
+		size_t result = 0;
+		for (; begin != end; ++begin)
+			result += count(*begin);
+
+		return result;
+	}
+
+protected:
+	virtual size_t visit(ModulePtr module) {
+		return 1 + count(module->decls.begin(), module->decls.end());
+	}
+
+	virtual size_t visit(FunctionDeclPtr function) {
+		return 1 + count(function->returnType) +
+		       count(function->parameters.begin(), function->parameters.end()) +
+		       count(function->body);
+	}
+
+	virtual size_t visit(VariableDeclPtr variable) {
+		return 1 + count(variable->type) + count(variable->initializer);
+	}
+
+	virtual size_t visit(ParameterDeclPtr parameter) {
+		return 1 + count(parameter->type);
+	}
+
+	virtual size_t visit(DelayedDeclPtr) { return 1; }
+
+	virtual size_t visit(IntegralTypePtr) { return 1; }
+	virtual size_t visit(NumberTypePtr) { return 1; }
+	virtual size_t visit(UndefinedTypePtr) { return 1; }
+	virtual size_t visit(DelayedTypePtr) { return 1; }
+
+	virtual size_t visit(FunctionTypePtr type) {
+		return 1 + count(type->returnType) +
+		       count(type->parameterTypes.begin(), type->parameterTypes.end());
+	}
+
+	virtual size_t visit(ArrayTypePtr type) {
+		return 1 + count(type->inner);
+	}
+
+	virtual size_t visit(BinaryExprPtr expr) {
+		return 1 + count(expr->left) + count(expr->right);
+	}
+
+	virtual size_t visit(LiteralNumberExprPtr) { return 1; }
+	virtual size_t visit(LiteralStringExprPtr) { return 1; }
+	virtual size_t visit(LiteralBoolExprPtr) { return 1; }
+
+	virtual size_t visit(BlockExprPtr block) {
+		return 1 + count(block->exprs.begin(), block->exprs.end());
+	}
+
+	virtual size_t visit(IfElseExprPtr expr) {
+		return 1 + count(expr->condition) + count(expr->ifExpr) +
+		       count(expr->elseExpr);
+	}
+
+	virtual size_t visit(VoidExprPtr) { return 1; }
+	virtual size_t visit(IdentifierExprPtr) { return 1; }
+
+	virtual size_t visit(CallExprPtr call) {
+		return 1 + count(call->callee) +
+		       count(call->arguments.begin(), call->arguments.end());
+	}
+
+	virtual size_t visit(DeclRefExprPtr) { return 1; }
+
+	virtual size_t visit(DeclExprPtr expr) {
+		return 1 + count(expr->decl);
+	}
+
+	virtual size_t visit(DelayedExprPtr) { return 1; }
+
+	virtual size_t visit(ArrayElementExprPtr expr) {
+		return 1 + count(expr->array) + count(expr->index);
+	}
+
+	virtual size_t visit(ImplicitCastExprPtr expr) {
+		return 1 + count(expr->expr);
+	}
+};
+
+} // namespace
+
+size_t countNodes(NodePtr node) {
+	return NodeCounter().count(node);
+}
+
+void annotateSpan(trace::Span& span, const SourceManager& sources,
+                  NodePtr node) {
+	if (!span.active())
+		return;
+
+	span.location(sources, node->location());
+	span.arg("nodes", countNodes(node));
+}
+
+} // namespace ast
+} // namespace llang
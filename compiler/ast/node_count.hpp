@@ -0,0 +1,28 @@
+#ifndef LLANG_AST_NODE_COUNT_HPP_INCLUDED
+#define LLANG_AST_NODE_COUNT_HPP_INCLUDED
+
+#include <cstddef>
+
+#include "common/trace_events.hpp"
+#include "ast/node.hpp"
+
+namespace llang {
+
+class SourceManager;
+
+namespace ast {
+
+// Number of nodes in the tree as written in the source: declarations,
+// expressions and the types spelled out in declarations. Types computed by
+// the semantic passes are shared and not counted.
+size_t countNodes(NodePtr node);
+
+// Adds the node's location and count to a span of --trace-json. Nothing is
+// counted if no events are written.
+void annotateSpan(trace::Span& span, const SourceManager& sources,
+                  NodePtr node);
+
+} // namespace ast
+} // namespace llang
+
+#endif
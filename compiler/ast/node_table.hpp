@@ -3,20 +3,26 @@
 
 // see http://www.drdobbs.com/blog/archives/2010/06/the_x_macro.html
 
-#define LLANG_AST_NODE_TABLE(X) \
+// Declarations, types and expressions each get consecutive tags, which is
+// what isA checks for Decl, Type and Expr. Subclasses are next to each
+// other for the same reason (ScopedDecl, VariableDecl).
+
+#define LLANG_AST_DECL_TABLE(X) \
 	X(Module, MODULE) \
 	X(FunctionDecl, FUNCTION_DECL) \
 	X(VariableDecl, VARIABLE_DECL) \
 	X(ParameterDecl, PARAMETER_DECL) \
-	X(DelayedDecl, DELAYED_DECL) \
-	\
+	X(DelayedDecl, DELAYED_DECL)
+
+#define LLANG_AST_TYPE_TABLE(X) \
 	X(IntegralType, INTEGRAL_TYPE) \
 	X(NumberType, NUMBER_TYPE) \
 	X(UndefinedType, UNDEFINED_TYPE) \
 	X(DelayedType, DELAYED_TYPE) \
 	X(FunctionType, FUNCTION_TYPE) \
-	X(ArrayType, ARRAY_TYPE) \
-	\
+	X(ArrayType, ARRAY_TYPE)
+
+#define LLANG_AST_EXPR_TABLE(X) \
 	X(BinaryExpr, BINARY_EXPR) \
 	X(LiteralNumberExpr, LITERAL_NUMBER_EXPR) \
 	X(LiteralStringExpr, LITERAL_STRING_EXPR) \
@@ -32,4 +38,9 @@
 	X(ArrayElementExpr, ARRAY_ELEMENT_EXPR) \
 	X(ImplicitCastExpr, IMPLICIT_CAST_EXPR)
 
+#define LLANG_AST_NODE_TABLE(X) \
+	LLANG_AST_DECL_TABLE(X) \
+	LLANG_AST_TYPE_TABLE(X) \
+	LLANG_AST_EXPR_TABLE(X)
+
 #endif
@@ -1,10 +1,12 @@
 #ifndef LLANG_AST_TYPE_HPP_INCLUDED
 #define LLANG_AST_TYPE_HPP_INCLUDED
 
-#include <list>
 #include <sstream>
 #include <string>
+#include <utility>
 
+#include "util/smart_ptr.hpp"
+#include "util/small_vector.hpp"
 #include "ast/node.hpp"
 #include "ast/decl_ptr.hpp"
 #include "ast/type_ptr.hpp"
@@ -14,15 +16,12 @@ namespace ast {
 
 class Type : public Node {
 public:
-	// TODO: consider making all types singletons to make
-	//       comparing them easier and faster
-	virtual bool equals(const Type* other) const = 0;
+	// Types made by the TypeContext are unique, so equal types are the same
+	// object
+	bool equals(const Type* other) const { return this == other; }
 	bool equals(const scoped_ptr<Type>& other) {
 		return equals(other.get());
 	}
-	bool equals(const shared_ptr<Type>& other) {
-		return equals(other.get());
-	}
 
 	virtual std::string name() const = 0;
 	virtual bool canCastImplicitly(const TypePtr) const;
@@ -41,12 +40,13 @@ public:
 		  delayedDecl(delayedDecl) {
 	}
 
-	virtual bool equals(const Type*) const { return false; }	
 	virtual std::string name() const { return "<undefined>"; }
 
 	DeclPtr delayedDecl;
 };
 
+typedef DelayedType* DelayedTypePtr;
+
 // Used internally
 class UndefinedType : public Type {
 public:
@@ -54,18 +54,16 @@ public:
 		: Type(Node::UNDEFINED_TYPE, location) {
 	}
 
-	virtual bool equals(const Type*) const { return false; }	
 	virtual std::string name() const { return "<undefined>"; }
 
 	static TypePtr singleton() {
 		// Have you ever seen a multithreaded compiler? Huh? HUH?!
-		static Location location("", 0, 0);
-		static shared_ptr<UndefinedType> ptr(new UndefinedType(location));
-		return ptr;
+		static UndefinedType type((Location()));
+		return &type;
 	}
 };
 
-typedef shared_ptr<UndefinedType> UndefinedTypePtr;
+typedef UndefinedType* UndefinedTypePtr;
 
 class IntegralType : public Type {
 public:
@@ -82,13 +80,6 @@ public:
 		  type(type) {
 	}
 
-	virtual bool equals(const Type* other) const {
-		const IntegralType* type = other->isA<IntegralType>();
-		if (!type) return false;
-
-		return type->type == this->type;
-	}
-
 	virtual std::string name() const {
 		switch (type) {
 		case IntegralType::I32:
@@ -109,7 +100,7 @@ public:
 	const IntegralType::Kind type;
 };
 
-typedef shared_ptr<IntegralType> IntegralTypePtr;
+typedef IntegralType* IntegralTypePtr;
 
 // Used internally
 class NumberType : public Type {
@@ -118,11 +109,6 @@ public:
 		: Type(Node::NUMBER_TYPE, location) {
 	}
 
-	virtual bool equals(const Type* other) const {
-		const NumberType* type = other->isA<NumberType>();
-		return type;
-	}
-
 	virtual std::string name() const {
 		return "<number>";
 	}
@@ -130,33 +116,20 @@ public:
 	virtual bool canCastImplicitly(const TypePtr) const;
 };
 
+typedef NumberType* NumberTypePtr;
+
 class FunctionType : public Type {
 public:
-	typedef std::list<TypePtr> ParameterTypeList;
+	static const bool ownsResources = true;
+
+	typedef SmallVector<TypePtr, 4> ParameterTypeList;
 
 	FunctionType(const Location& location,
 	             TypePtr returnType, 
-	             ParameterTypeList& parameterTypes)
+	             ParameterTypeList&& parameterTypes)
 		: Type(Node::FUNCTION_TYPE, location),
 		  returnType(returnType),
-		  parameterTypes(parameterTypes) {
-	}
-
-	virtual bool equals(const Type* other) const {
-		const FunctionType* type = other->isA<FunctionType>();
-		if (!type) return false;
-		
-		if (!type->returnType->equals(returnType)) return false;
-		if (parameterTypes.size() != type->parameterTypes.size()) return false;
-
-		for (auto it1 = parameterTypes.begin(),
-		          it2 = type->parameterTypes.begin();
-		     it1 != parameterTypes.end();
-		     ++it1, ++it2) {
-			if (!(*it1)->equals(*it2)) return false;
-		}
-
-		return true;
+		  parameterTypes(std::move(parameterTypes)) {
 	}
 
 	virtual std::string name() const {
@@ -185,7 +158,7 @@ public:
 	ParameterTypeList parameterTypes;	
 };
 
-typedef shared_ptr<FunctionType> FunctionTypePtr;
+typedef FunctionType* FunctionTypePtr;
 
 class ArrayType : public Type {
 public:
@@ -195,13 +168,6 @@ public:
 		: Type(Node::ARRAY_TYPE, location), inner(inner) {
 	}
 
-	virtual bool equals(const Type* other) const {
-		const ArrayType* type = other->isA<ArrayType>();
-		if (!type) return false;
-
-		return type->inner->equals(inner);
-	}
-
 	virtual std::string name() const {
 		std::stringstream ss;
 
@@ -211,7 +177,7 @@ public:
 	}
 };
 
-typedef shared_ptr<ArrayType> ArrayTypePtr;
+typedef ArrayType* ArrayTypePtr;
 
 } // namespace ast
 } // namespace llang
@@ -0,0 +1,70 @@
+#include <cassert>
+
+#include "ast/type_context.hpp"
+
+namespace llang {
+namespace ast {
+
+TypeContext::TypeContext(Arena& arena)
+	: arena(arena) {
+	for (size_t i = 0; i < IntegralType::STRING; ++i)
+		integrals[i] = 0;
+}
+
+IntegralTypePtr TypeContext::integral(IntegralType::Kind kind) {
+	assert(kind < IntegralType::STRING);
+
+	IntegralTypePtr& type = integrals[kind];
+	if (!type)
+		type = arena.make<IntegralType>(Location(), kind);
+
+	return type;
+}
+
+ArrayTypePtr TypeContext::array(TypePtr inner) {
+	ArrayTypePtr& type = arrays[inner];
+	if (!type)
+		type = arena.make<ArrayType>(Location(), inner);
+
+	return type;
+}
+
+FunctionTypePtr TypeContext::function(TypePtr returnType,
+	FunctionType::ParameterTypeList&& parameterTypes) {
+	FunctionTypePtr& type = functions[functionKey(returnType, parameterTypes)];
+
+	if (!type) {
+		type = arena.make<FunctionType>(Location(), returnType,
+		                                std::move(parameterTypes));
+	}
+
+	return type;
+}
+
+void TypeContext::adopt(TypePtr type) {
+	if (IntegralTypePtr integral = isA<IntegralType>(type)) {
+		if (integral->type < IntegralType::STRING &&
+		    !integrals[integral->type])
+			integrals[integral->type] = integral;
+	} else if (ArrayTypePtr array = isA<ArrayType>(type)) {
+		arrays.insert(std::make_pair(array->inner, array));
+	} else if (FunctionTypePtr function = isA<FunctionType>(type)) {
+		functions.insert(std::make_pair(
+			functionKey(function->returnType, function->parameterTypes),
+			function));
+	}
+}
+
+TypeContext::FunctionKey TypeContext::functionKey(TypePtr returnType,
+	const FunctionType::ParameterTypeList& parameterTypes) {
+	FunctionKey key;
+	key.reserve(parameterTypes.size() + 1);
+
+	key.push_back(returnType);
+	key.insert(key.end(), parameterTypes.begin(), parameterTypes.end());
+
+	return key;
+}
+
+} // namespace ast
+} // namespace llang
@@ -0,0 +1,56 @@
+#ifndef LLANG_AST_TYPE_CONTEXT_HPP_INCLUDED
+#define LLANG_AST_TYPE_CONTEXT_HPP_INCLUDED
+
+#include <map>
+#include <vector>
+
+#include "ast/arena.hpp"
+#include "ast/type.hpp"
+
+namespace llang {
+namespace ast {
+
+// Makes every type only once, so that equal types are the same object and
+// Type::equals compares pointers. The types are allocated in the arena of
+// the module they belong to and have no location.
+//
+// The parser creates types as they are written; the first semantic phase
+// replaces them with the ones from here.
+class TypeContext {
+public:
+	explicit TypeContext(Arena& arena);
+
+	// STRING is not a type of its own, it's arr[char]
+	IntegralTypePtr integral(IntegralType::Kind kind);
+
+	ArrayTypePtr array(TypePtr inner);
+
+	FunctionTypePtr function(TypePtr returnType,
+		FunctionType::ParameterTypeList&& parameterTypes);
+
+	// Makes a type that was created elsewhere the one returned for its
+	// parts, unless there already is one. For types read back from a cache,
+	// which were unique when they were written.
+	void adopt(TypePtr type);
+
+private:
+	TypeContext(const TypeContext&);
+	TypeContext& operator=(const TypeContext&);
+
+	// The return type followed by the parameter types
+	typedef std::vector<TypePtr> FunctionKey;
+
+	static FunctionKey functionKey(TypePtr returnType,
+		const FunctionType::ParameterTypeList& parameterTypes);
+
+	Arena& arena;
+
+	IntegralTypePtr integrals[IntegralType::STRING];
+	std::map<TypePtr, ArrayTypePtr> arrays;
+	std::map<FunctionKey, FunctionTypePtr> functions;
+};
+
+} // namespace ast
+} // namespace llang
+
+#endif
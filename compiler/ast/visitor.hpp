@@ -10,8 +10,8 @@ namespace ast {
 #define LLANG_VISITOR_TABLE_PARAM           LLANG_AST_NODE_TABLE
 #define LLANG_VISITOR_TYPE_PARAM            Node
 #define LLANG_VISITOR_TAG_PARAM             tag
-#define LLANG_VISITOR_TYPE_WRAP_PARAM(type) shared_ptr<type>
-#define LLANG_VISITOR_CAST_PARAM(type)      static_pointer_cast<type>
+#define LLANG_VISITOR_TYPE_WRAP_PARAM(type) type*
+#define LLANG_VISITOR_CAST_PARAM(type)      nodeCast<type>
 #define LLANG_VISITOR_MEMBER_PARAM          ->
 
 #include "util/make_visitor.hpp"
@@ -0,0 +1,1365 @@
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iterator>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "common/trace.hpp"
+#include "ast/type.hpp"
+#include "ast/decl.hpp"
+#include "ast/expr.hpp"
+#include "ast/visitor.hpp"
+#include "semantic/scope.hpp"
+#include "cache/module_cache.hpp"
+
+namespace llang {
+namespace cache {
+
+using namespace ast;
+using semantic::Scope;
+using semantic::ScopePtr;
+
+namespace {
+
+// Bump when the layout changes, or what the semantic phases leave in the
+// tree
+const uint32_t version = 3;
+
+const char magic[4] = { 'L', 'L', 'A', 'C' };
+
+// Bytes from the start of the file
+struct Section {
+	uint32_t offset;
+	uint32_t size;
+};
+
+struct Header {
+	char magic[4];
+	uint32_t version;
+	uint64_t sourceHash;
+
+	uint32_t nodeCount;
+	uint32_t declCount;
+	uint32_t typeCount;
+	uint32_t scopeCount;
+	uint32_t identifierCount;
+
+	Section nodes; // the module's record, see Writer
+	Section identifiers; // per identifier: number, length, text
+};
+
+// In place of a node's tag where a child is null
+const unsigned char nullTag = 0xff;
+
+// FNV-1a
+uint64_t hash(const char* start, size_t length) {
+	uint64_t h = 14695981039346656037ull;
+
+	for (size_t i = 0; i < length; ++i) {
+		h ^= static_cast<unsigned char>(start[i]);
+		h *= 1099511628211ull;
+	}
+
+	return h;
+}
+
+// Small negative numbers get small codes: 0, -1, 1, -2, ... become
+// 0, 1, 2, 3, ...
+uint64_t zigzag(int64_t value) {
+	return (static_cast<uint64_t>(value) << 1) ^
+	       static_cast<uint64_t>(value >> 63);
+}
+
+int64_t unzigzag(uint64_t value) {
+	return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
+// The types of these expressions follow from the expression, so they aren't
+// written but set again by Reader::deriveTypes
+bool hasDerivedType(Node::Tag tag) {
+	switch (tag) {
+	case Node::LITERAL_NUMBER_EXPR:
+	case Node::LITERAL_STRING_EXPR:
+	case Node::LITERAL_BOOL_EXPR:
+	case Node::VOID_EXPR:
+	case Node::DECL_EXPR:
+	case Node::DECL_REF_EXPR:
+		return true;
+
+	default:
+		return false;
+	}
+}
+
+// Numbers pointers in the order they are added. Open addressing like the
+// Interner's table, but the slots keep the pointer next to its index, so
+// that a probe touches one cache line.
+template<typename T>
+class RefTable {
+public:
+	RefTable() : count(0), slots(1024) {}
+
+	// Returns the pointer's index + 1, adding it if it's new
+	uint32_t insert(T* pointer) {
+		const size_t mask = slots.size() - 1;
+
+		size_t slot = hash(pointer) & mask;
+		while (slots[slot].pointer) {
+			if (slots[slot].pointer == pointer)
+				return slots[slot].entry;
+
+			slot = (slot + 1) & mask;
+		}
+
+		const uint32_t entry = ++count;
+		slots[slot].pointer = pointer;
+		slots[slot].entry = entry;
+
+		// Keep the load factor below 1/2
+		if (count * 2 > slots.size())
+			grow();
+
+		return entry;
+	}
+
+	// Returns the pointer's index + 1, or 0 if it hasn't been added
+	uint32_t find(T* pointer) const {
+		const size_t mask = slots.size() - 1;
+
+		for (size_t slot = hash(pointer) & mask; slots[slot].pointer;
+		     slot = (slot + 1) & mask) {
+			if (slots[slot].pointer == pointer)
+				return slots[slot].entry;
+		}
+
+		return 0;
+	}
+
+	size_t size() const { return count; }
+
+private:
+	struct Slot {
+		T* pointer; // null if empty
+		uint32_t entry;
+
+		Slot() : pointer(0), entry(0) {}
+	};
+
+	static size_t hash(T* pointer) {
+		// Arena nodes are next to each other in the order they were made,
+		// which is close to the order they're written in, so neighbours
+		// are kept together. The low bits are alignment.
+		return reinterpret_cast<uintptr_t>(pointer) >> 3;
+	}
+
+	void grow() {
+		std::vector<Slot> newSlots(slots.size() * 2);
+		const size_t mask = newSlots.size() - 1;
+
+		for (size_t i = 0; i < slots.size(); ++i) {
+			if (!slots[i].pointer) continue;
+
+			size_t slot = hash(slots[i].pointer) & mask;
+			while (newSlots[slot].pointer) slot = (slot + 1) & mask;
+
+			newSlots[slot] = slots[i];
+		}
+
+		slots.swap(newSlots);
+	}
+
+	uint32_t count;
+	std::vector<Slot> slots;
+};
+
+// Serializes the module straight to the file, as the records of its nodes
+// in preorder: a node's children (the nodes it owns, like a function's
+// parameters and body) follow its record, so they need no references. A
+// record starts with the tag, or nullTag for a missing child, and the
+// location as the distance to the last valid one before it (0 for none).
+// All numbers are unsigned LEB128 varints, so most take a byte.
+//
+// Everything else is numbered in the order it's first written or
+// referenced, in the same order in which the reader sees it:
+//
+//   - Decls, as they can be referenced before they are written (calls of
+//     functions further down). A decl record and a reference give the
+//     number as the distance from the last number given out, or say that
+//     it's the next one.
+//   - Types, which are written where they are first referenced, and
+//     referenced like decls after that.
+//   - Scopes, which are written with the node that owns them: the
+//     reference to the parent before the children, the (name, decl) pairs
+//     after them. Only scopes written before can be referenced, which
+//     holds for the parents of scopes and the scopes of declarations.
+//
+// Types that follow from the node aren't written (see hasDerivedType), and
+// neither is what the reader can tell from other fields, like
+// FunctionDecl::isNested.
+//
+// Identifiers are numbered in the order they are first used, and written
+// at the end in the order of the interner's ids, so that reading them back
+// in that order keeps their relative order, which is the order scopes
+// iterate in.
+class Writer : public Visitor<void, void> {
+public:
+	Writer(const Context& context, SourceManager::FileId file, FILE* out)
+		: identifiers(context.identifiers),
+		  base(context.sources.location(file, 0).offset),
+		  out(out), flushed(0), failed(false), lastLocation(0),
+		  nodeCount(0), writtenDecls(0),
+		  identifierNumbers(context.identifiers.size(), 0),
+		  identifierCount(0) {
+	}
+
+	// Returns false if writing to the file failed, or the module can't be
+	// written
+	bool write(Module& module, uint64_t sourceHash);
+
+	// Bytes written so far
+	uint64_t size() const { return flushed + buffer.size(); }
+
+protected:
+	virtual void visit(ModulePtr module) {
+		beginDecl(module);
+		beginScope(module->scope.get());
+		putChildren(module->decls.begin(), module->decls.end());
+		endScope(module->scope.get());
+	}
+
+	virtual void visit(FunctionDeclPtr function) {
+		beginDecl(function);
+		put(function->isExtern);
+		putScope(function->declScope);
+		beginScope(function->scope.get());
+		putType(function->returnType);
+		putChildren(function->parameters.begin(),
+		            function->parameters.end());
+		putChild(function->body);
+		putType(function->type);
+		put(function->outerVariables.size());
+		for (auto it = function->outerVariables.begin();
+		     it != function->outerVariables.end();
+		     ++it)
+			putDecl(*it);
+		putDecl(function->parentFunction);
+		endScope(function->scope.get());
+	}
+
+	virtual void visit(VariableDeclPtr variable) {
+		beginDecl(variable);
+		putScope(variable->declScope);
+		putVariable(variable);
+	}
+
+	virtual void visit(ParameterDeclPtr parameter) {
+		beginDecl(parameter);
+		put(parameter->hasName);
+		putScope(parameter->declScope);
+		putVariable(parameter);
+	}
+
+	virtual void visit(DelayedDeclPtr delayed) {
+		beginDecl(delayed);
+		putScope(delayed->declScope);
+	}
+
+	virtual void visit(IntegralTypePtr type) {
+		beginRecord(type);
+		put(type->type);
+	}
+
+	virtual void visit(NumberTypePtr type) {
+		beginRecord(type);
+	}
+
+	virtual void visit(UndefinedTypePtr type) {
+		beginRecord(type);
+	}
+
+	virtual void visit(DelayedTypePtr type) {
+		beginRecord(type);
+		putDecl(type->delayedDecl);
+	}
+
+	virtual void visit(FunctionTypePtr type) {
+		beginRecord(type);
+		putType(type->returnType);
+		put(type->parameterTypes.size());
+		for (auto it = type->parameterTypes.begin();
+		     it != type->parameterTypes.end();
+		     ++it)
+			putType(*it);
+	}
+
+	virtual void visit(ArrayTypePtr type) {
+		beginRecord(type);
+		putType(type->inner);
+	}
+
+	virtual void visit(BinaryExprPtr binary) {
+		beginRecord(binary);
+		put(binary->operation);
+		putExprType(binary);
+		putChild(binary->left);
+		putChild(binary->right);
+	}
+
+	virtual void visit(LiteralNumberExprPtr literal) {
+		beginRecord(literal);
+		put(zigzag(literal->number));
+	}
+
+	virtual void visit(LiteralStringExprPtr literal) {
+		beginRecord(literal);
+		put(literal->literal.length);
+		putBytes(literal->literal.data, literal->literal.length);
+	}
+
+	virtual void visit(LiteralBoolExprPtr literal) {
+		beginRecord(literal);
+		put(literal->value);
+	}
+
+	virtual void visit(BlockExprPtr block) {
+		beginRecord(block);
+		putExprType(block);
+		beginScope(block->scope.get());
+		putChildren(block->exprs.begin(), block->exprs.end());
+		endScope(block->scope.get());
+	}
+
+	virtual void visit(IfElseExprPtr ifElse) {
+		beginRecord(ifElse);
+		putExprType(ifElse);
+		putChild(ifElse->condition);
+		putChild(ifElse->ifExpr);
+		putChild(ifElse->elseExpr);
+	}
+
+	virtual void visit(VoidExprPtr voidExpr) {
+		beginRecord(voidExpr);
+	}
+
+	// These don't survive the semantic phases
+	virtual void visit(IdentifierExprPtr identifier) {
+		beginRecord(identifier);
+		put(number(identifier->name));
+		putExprType(identifier);
+	}
+
+	virtual void visit(CallExprPtr call) {
+		beginRecord(call);
+		putExprType(call);
+		putChild(call->callee);
+		putChildren(call->arguments.begin(), call->arguments.end());
+	}
+
+	virtual void visit(DeclRefExprPtr declRef) {
+		beginRecord(declRef);
+		putDecl(declRef->decl);
+	}
+
+	virtual void visit(DeclExprPtr declExpr) {
+		beginRecord(declExpr);
+		putChild(declExpr->decl);
+	}
+
+	virtual void visit(DelayedExprPtr delayed) {
+		beginRecord(delayed);
+		putExprType(delayed);
+		putDecl(delayed->delayedDecl);
+	}
+
+	virtual void visit(ArrayElementExprPtr element) {
+		beginRecord(element);
+		putExprType(element);
+		putChild(element->array);
+		putChild(element->index);
+	}
+
+	virtual void visit(ImplicitCastExprPtr cast) {
+		beginRecord(cast);
+		putExprType(cast);
+		putChild(cast->expr);
+	}
+
+private:
+	void put(uint64_t value) {
+		for (; value >= 0x80; value >>= 7)
+			buffer.push_back(static_cast<unsigned char>(value | 0x80));
+		buffer.push_back(static_cast<unsigned char>(value));
+	}
+
+	void putBytes(const char* data, size_t size) {
+		buffer.insert(buffer.end(), data, data + size);
+	}
+
+	void flush() {
+		if (fwrite(buffer.data(), 1, buffer.size(), out) != buffer.size())
+			failed = true;
+
+		flushed += buffer.size();
+		buffer.clear();
+	}
+
+	void beginRecord(NodePtr node) {
+		if (buffer.size() >= bufferSize)
+			flush();
+
+		++nodeCount;
+		buffer.push_back(static_cast<unsigned char>(node->tag));
+
+		const Location location = node->location();
+		if (location.isValid()) {
+			const uint32_t value = location.offset - base;
+			put(zigzag(static_cast<int64_t>(value) - lastLocation) + 1);
+			lastLocation = value;
+		} else {
+			put(0);
+		}
+	}
+
+	void beginDecl(DeclPtr decl) {
+		beginRecord(decl);
+
+		const size_t last = decls.size();
+		const uint32_t number = decls.insert(decl);
+		put(number > last ? 0 : last - number + 1);
+		++writtenDecls;
+
+		put(this->number(decl->name));
+	}
+
+	void putChild(NodePtr node) {
+		if (node)
+			accept(node);
+		else
+			buffer.push_back(nullTag);
+	}
+
+	template <typename Iterator>
+	void putChildren(Iterator begin, Iterator end) {
+		put(static_cast<uint64_t>(std::distance(begin, end)));
+		for (; begin != end; ++begin)
+			putChild(*begin);
+	}
+
+	// 0 for null, 1 for a new one, else 2 + the distance to the last number
+	// given out
+	template <typename T> bool putRef(RefTable<T>& table, T* pointer) {
+		if (!pointer) {
+			put(0);
+			return false;
+		}
+
+		const size_t last = table.size();
+		const uint32_t number = table.insert(pointer);
+		if (number > last) {
+			put(1);
+			return true;
+		}
+
+		put(last - number + 2);
+		return false;
+	}
+
+	void putDecl(DeclPtr decl) {
+		putRef(decls, decl);
+	}
+
+	// A new type is written right after the reference
+	void putType(TypePtr type) {
+		if (putRef(types, type))
+			accept(type);
+	}
+
+	void putExprType(ExprPtr expr) {
+		assert(!hasDerivedType(expr->tag));
+		putType(expr->type);
+	}
+
+	void putVariable(VariableDeclPtr variable) {
+		putType(variable->type);
+		putChild(variable->initializer);
+		putDecl(variable->function);
+	}
+
+	void putScope(Scope* scope) {
+		put(scopeRef(scope));
+	}
+
+	// 0 for null, else 1 + the distance to the last scope
+	uint64_t scopeRef(Scope* scope) {
+		if (!scope) return 0;
+
+		const uint32_t number = scopes.find(scope);
+		if (!number) {
+			// Not written (yet), which the format can't express
+			failed = true;
+			return 0;
+		}
+
+		return scopes.size() - number + 1;
+	}
+
+	// 0 for none, else 1 + the reference to the parent
+	void beginScope(Scope* scope) {
+		if (!scope) {
+			put(0);
+			return;
+		}
+
+		put(scopeRef(scope->parent()) + 1);
+
+		// A scope with two owners would be read as two
+		const size_t last = scopes.size();
+		if (scopes.insert(scope) <= last)
+			failed = true;
+	}
+
+	void endScope(Scope* scope) {
+		if (!scope) return;
+
+		put(scope->decls.size());
+		for (auto it = scope->decls.begin(); it != scope->decls.end(); ++it) {
+			put(number(it->first));
+			putDecl(it->second);
+		}
+	}
+
+	// 0 for the empty identifier
+	uint32_t number(Identifier identifier) {
+		if (identifier.empty()) return 0;
+
+		uint32_t& number = identifierNumbers[identifier.id()];
+		if (!number) number = ++identifierCount;
+
+		return number;
+	}
+
+	void writeIdentifiers();
+
+	const Interner& identifiers;
+	const uint32_t base; // of the file's locations
+
+	FILE* const out;
+	uint64_t flushed; // bytes written to the file so far
+	bool failed;
+
+	// Written to the file in blocks of about this size
+	static const size_t bufferSize = 64 * 1024;
+	std::vector<unsigned char> buffer;
+
+	int64_t lastLocation;
+	uint32_t nodeCount;
+
+	RefTable<Decl> decls;
+	size_t writtenDecls; // the others have only been referenced
+	RefTable<Type> types;
+	RefTable<Scope> scopes;
+
+	std::vector<uint32_t> identifierNumbers; // indexed by id, 0 if unused
+	uint32_t identifierCount;
+};
+
+void Writer::writeIdentifiers() {
+	for (uint32_t id = 0; id < identifierNumbers.size(); ++id) {
+		if (!identifierNumbers[id]) continue;
+
+		const std::string& name = identifiers.str(Identifier(id));
+
+		put(identifierNumbers[id] - 1);
+		put(name.size());
+		putBytes(name.data(), name.size());
+
+		if (buffer.size() >= bufferSize)
+			flush();
+	}
+}
+
+bool Writer::write(Module& module, uint64_t sourceHash) {
+	buffer.reserve(bufferSize);
+
+	// Filled in at the end
+	Header header;
+	std::memset(&header, 0, sizeof(header));
+	putBytes(reinterpret_cast<const char*>(&header), sizeof(header));
+
+	header.nodes.offset = static_cast<uint32_t>(size());
+	accept(&module);
+	header.nodes.size = static_cast<uint32_t>(size() - header.nodes.offset);
+
+	header.identifiers.offset = static_cast<uint32_t>(size());
+	writeIdentifiers();
+	header.identifiers.size =
+		static_cast<uint32_t>(size() - header.identifiers.offset);
+
+	flush();
+
+	// A decl that is referenced but not part of the tree has no record
+	if (failed || writtenDecls != decls.size() || size() > UINT32_MAX)
+		return false;
+
+	std::memcpy(header.magic, magic, sizeof(magic));
+	header.version = version;
+	header.sourceHash = sourceHash;
+	header.nodeCount = nodeCount;
+	header.declCount = static_cast<uint32_t>(decls.size());
+	header.typeCount = static_cast<uint32_t>(types.size());
+	header.scopeCount = static_cast<uint32_t>(scopes.size());
+	header.identifierCount = identifierCount;
+
+	return fseek(out, 0, SEEK_SET) == 0 &&
+	       fwrite(&header, sizeof(header), 1, out) == 1;
+}
+
+// Thrown by Reader if the file is damaged
+struct Invalid {};
+
+class Bytes {
+public:
+	Bytes(const unsigned char* begin, const unsigned char* end)
+		: position(begin), end(end) {
+	}
+
+	uint64_t varint() {
+		uint64_t value = 0;
+
+		for (unsigned shift = 0; ; shift += 7) {
+			if (position == end || shift > 63) throw Invalid();
+
+			const unsigned char byte = *position++;
+			value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+
+			if (!(byte & 0x80))
+				return value;
+		}
+	}
+
+	uint32_t next() {
+		const uint64_t value = varint();
+		if (value > UINT32_MAX) throw Invalid();
+
+		return static_cast<uint32_t>(value);
+	}
+
+	unsigned char byte() {
+		if (position == end) throw Invalid();
+		return *position++;
+	}
+
+	const char* take(size_t length) {
+		if (length > left()) throw Invalid();
+
+		const char* start = reinterpret_cast<const char*>(position);
+		position += length;
+
+		return start;
+	}
+
+	bool atEnd() const { return position == end; }
+	size_t left() const { return static_cast<size_t>(end - position); }
+
+	const unsigned char* position;
+	const unsigned char* end;
+};
+
+// Reads the records in one pass, the layouts are the ones of Writer.
+// References to decls that haven't been read yet are filled in at the end.
+class Reader {
+public:
+	Reader(Context& context, SourceManager::FileId file,
+	       const char* data, size_t size)
+		: context(context),
+		  base(context.sources.location(file, 0).offset),
+		  data(data), size(size), header(0), module(0),
+		  lastLocation(0), nodeCount(0), declCount(0) {
+	}
+
+	~Reader() {
+		delete module; // unless read succeeded
+	}
+
+	// Throws Invalid
+	ModulePtr read(uint64_t sourceHash);
+
+private:
+	// A reference to a decl further down
+	struct Fixup {
+		void* slot;
+		uint32_t number;
+		void (*set)(void* slot, DeclPtr decl);
+	};
+
+	Bytes section(const Section& section) const;
+	void readIdentifiers();
+
+	NodePtr readNode(Bytes& in);
+	NodePtr readRecord(Node::Tag tag, Location location, Bytes& in);
+
+	template <typename T> T* child(Bytes& in) {
+		NodePtr node = readNode(in);
+		if (!node) return 0;
+
+		T* result = isA<T>(node);
+		if (!result) throw Invalid();
+
+		return result;
+	}
+
+	template <typename T, typename List> void readChildren(Bytes& in,
+	                                                        List& list) {
+		const uint32_t count = in.next();
+		if (count > in.left()) throw Invalid();
+
+		list.reserve(count);
+		for (uint32_t i = 0; i < count; ++i)
+			list.push_back(child<T>(in));
+	}
+
+	// 0 for null, else the number of a decl or type, see Writer::putRef
+	static uint32_t number(uint32_t value, uint32_t& last) {
+		if (value == 0) return 0;
+		if (value == 1) return ++last;
+		if (value - 2 >= last) throw Invalid();
+
+		return last - (value - 2);
+	}
+
+	template <typename T> void readDecl(Bytes& in, T*& slot) {
+		slot = 0;
+
+		const uint32_t number = this->number(in.next(), declCount);
+		if (!number) return;
+		if (number > decls.size()) throw Invalid();
+
+		if (DeclPtr decl = decls[number - 1]) {
+			setDecl<T>(&slot, decl);
+		} else {
+			Fixup fixup = { &slot, number, &setDecl<T> };
+			fixups.push_back(fixup);
+		}
+	}
+
+	template <typename T> static void setDecl(void* slot, DeclPtr decl) {
+		T* result = isA<T>(decl);
+		if (!result) throw Invalid();
+
+		*static_cast<T**>(slot) = result;
+	}
+
+	// The number of the decl whose record starts here
+	void addDecl(DeclPtr decl, uint32_t value);
+
+	TypePtr readType(Bytes& in);
+
+	Scope* scope(Bytes& in) const {
+		const uint32_t value = in.next();
+		if (!value) return 0;
+		if (value > scopes.size()) throw Invalid();
+
+		return scopes[scopes.size() - value].get();
+	}
+
+	ScopePtr beginScope(Bytes& in);
+	void endScope(Bytes& in, Scope* scope);
+
+	void resolveDecls();
+	void deriveTypes();
+
+	Arena& arena() {
+		if (!module) throw Invalid();
+		return module->arena;
+	}
+
+	identifier_t identifier(uint32_t number) const {
+		if (!number) return identifier_t();
+		if (number > identifiers.size()) throw Invalid();
+
+		return identifiers[number - 1];
+	}
+
+	Context& context;
+	const uint32_t base;
+
+	const char* data;
+	const size_t size;
+	const Header* header;
+
+	ModulePtr module;
+
+	// From the written numbers to the identifiers in this context
+	std::vector<identifier_t> identifiers;
+
+	int64_t lastLocation;
+	uint32_t nodeCount;
+
+	std::vector<DeclPtr> decls; // by number, null until read
+	uint32_t declCount; // numbers given out so far
+	std::vector<Fixup> fixups;
+
+	std::vector<TypePtr> types;
+	std::vector<ScopePtr> scopes;
+
+	std::vector<ExprPtr> derivedTypes; // see deriveTypes
+};
+
+ModulePtr Reader::read(uint64_t sourceHash) {
+	if (size < sizeof(Header)) throw Invalid();
+	header = reinterpret_cast<const Header*>(data);
+
+	if (std::memcmp(header->magic, magic, sizeof(magic)) != 0 ||
+	    header->version != version || header->sourceHash != sourceHash)
+		throw Invalid();
+
+	readIdentifiers();
+
+	Bytes in = section(header->nodes);
+
+	// Every record takes at least two bytes
+	if (header->declCount > in.left() / 2) throw Invalid();
+	decls.resize(header->declCount);
+
+	if (!isA<Module>(readNode(in)) || !in.atEnd()) throw Invalid();
+
+	if (nodeCount != header->nodeCount ||
+	    declCount != header->declCount ||
+	    types.size() != header->typeCount ||
+	    scopes.size() != header->scopeCount)
+		throw Invalid();
+
+	resolveDecls();
+	deriveTypes();
+
+	ModulePtr result = module;
+	module = 0;
+
+	return result;
+}
+
+Bytes Reader::section(const Section& section) const {
+	if (section.offset > size || section.size > size - section.offset)
+		throw Invalid();
+
+	const unsigned char* begin =
+		reinterpret_cast<const unsigned char*>(data + section.offset);
+	return Bytes(begin, begin + section.size);
+}
+
+void Reader::readIdentifiers() {
+	Bytes in = section(header->identifiers);
+
+	// Every entry takes at least two bytes
+	if (header->identifierCount > in.left() / 2) throw Invalid();
+	identifiers.resize(header->identifierCount);
+
+	// Interning in the written order keeps the order of the ids
+	while (!in.atEnd()) {
+		const uint32_t number = in.next();
+		const uint32_t length = in.next();
+
+		if (number >= identifiers.size()) throw Invalid();
+		identifiers[number] = context.identifiers.intern(in.take(length),
+		                                                 length);
+	}
+}
+
+NodePtr Reader::readNode(Bytes& in) {
+	const unsigned char tag = in.byte();
+	if (tag == nullTag) return 0;
+
+	Location location;
+	if (const uint64_t value = in.varint()) {
+		lastLocation += unzigzag(value - 1);
+		location = Location(base + static_cast<uint32_t>(lastLocation));
+	}
+
+	++nodeCount;
+	return readRecord(static_cast<Node::Tag>(tag), location, in);
+}
+
+void Reader::addDecl(DeclPtr decl, uint32_t value) {
+	// Like a reference, but the decl isn't null
+	const uint32_t number = this->number(value + 1, declCount);
+	if (number > decls.size() || decls[number - 1]) throw Invalid();
+
+	decls[number - 1] = decl;
+}
+
+TypePtr Reader::readType(Bytes& in) {
+	const uint32_t value = in.next();
+	uint32_t last = static_cast<uint32_t>(types.size());
+
+	const uint32_t number = this->number(value, last);
+	if (!number) return 0;
+
+	if (number <= types.size()) {
+		if (!types[number - 1]) throw Invalid();
+		return types[number - 1];
+	}
+
+	// New, numbered before the types it refers to
+	types.push_back(0);
+	TypePtr type = child<Type>(in);
+	if (!type) throw Invalid();
+
+	return types[number - 1] = type;
+}
+
+ScopePtr Reader::beginScope(Bytes& in) {
+	const uint32_t value = in.next();
+	if (!value) return ScopePtr();
+
+	// The parent, like Reader::scope
+	Scope* parent = 0;
+	if (value > 1) {
+		if (value - 1 > scopes.size()) throw Invalid();
+		parent = scopes[scopes.size() - (value - 1)].get();
+	}
+
+	scopes.push_back(ScopePtr(new Scope(parent)));
+	return scopes.back();
+}
+
+void Reader::endScope(Bytes& in, Scope* scope) {
+	if (!scope) return;
+
+	const uint32_t count = in.next();
+	if (count > in.left() / 2) throw Invalid();
+
+	for (uint32_t i = 0; i < count; ++i) {
+		const identifier_t name = identifier(in.next());
+
+		DeclPtr& decl = scope->decls.insert(
+			Scope::DeclMap::value_type(name, DeclPtr())).first->second;
+		readDecl(in, decl);
+	}
+}
+
+// Creates the node, with its children
+NodePtr Reader::readRecord(Node::Tag tag, Location location, Bytes& in) {
+	// Decls have their number and name first
+	uint32_t declValue = 0;
+	identifier_t name;
+	if (tag <= Node::LAST_DECL) {
+		declValue = in.next();
+		name = identifier(in.next());
+	}
+
+	switch (tag) {
+	case Node::MODULE: {
+		if (module) throw Invalid();
+
+		module = new Module(location, name);
+		addDecl(module, declValue);
+
+		module->scope = beginScope(in);
+		readChildren<Decl>(in, module->decls);
+		endScope(in, module->scope.get());
+
+		return module;
+	}
+
+	case Node::FUNCTION_DECL: {
+		FunctionDeclPtr function = arena().make<FunctionDecl>(location, name,
+			TypePtr(), FunctionDecl::ParameterList(), ExprPtr());
+		addDecl(function, declValue);
+
+		function->isExtern = in.next() != 0;
+		function->declScope = scope(in);
+		function->scope = beginScope(in);
+		function->returnType = readType(in);
+		readChildren<ParameterDecl>(in, function->parameters);
+		function->body = child<Expr>(in);
+		function->type = readType(in);
+
+		const uint32_t count = in.next();
+		if (count > in.left()) throw Invalid();
+
+		for (uint32_t i = 0; i < count; ++i) {
+			function->outerVariables.push_back(0);
+			readDecl(in, function->outerVariables.back());
+		}
+
+		readDecl(in, function->parentFunction);
+		function->isNested = function->parentFunction != 0;
+
+		endScope(in, function->scope.get());
+
+		return function;
+	}
+
+	case Node::VARIABLE_DECL:
+	case Node::PARAMETER_DECL: {
+		VariableDeclPtr variable;
+
+		if (tag == Node::PARAMETER_DECL) {
+			const bool hasName = in.next() != 0;
+			variable = arena().make<ParameterDecl>(location, name, hasName,
+			                                       TypePtr());
+		} else {
+			variable = arena().make<VariableDecl>(location, name, TypePtr(),
+			                                      ExprPtr());
+		}
+
+		addDecl(variable, declValue);
+
+		variable->declScope = scope(in);
+		variable->type = readType(in);
+		variable->initializer = child<Expr>(in);
+		readDecl(in, variable->function);
+
+		return variable;
+	}
+
+	case Node::DELAYED_DECL: {
+		DelayedDeclPtr delayed = arena().make<DelayedDecl>(location, name);
+		addDecl(delayed, declValue);
+
+		delayed->declScope = scope(in);
+
+		return delayed;
+	}
+
+	// Types were unique when they were written, and are the module's types
+	// again
+	case Node::INTEGRAL_TYPE: {
+		const uint32_t kind = in.next();
+		if (kind > IntegralType::STRING) throw Invalid();
+
+		IntegralTypePtr type = arena().make<IntegralType>(location,
+			static_cast<IntegralType::Kind>(kind));
+		module->types.adopt(type);
+
+		return type;
+	}
+
+	case Node::NUMBER_TYPE:
+		return arena().make<NumberType>(location);
+
+	case Node::UNDEFINED_TYPE:
+		return arena().make<UndefinedType>(location);
+
+	case Node::DELAYED_TYPE: {
+		DelayedTypePtr type = arena().make<DelayedType>(location, DeclPtr());
+		readDecl(in, type->delayedDecl);
+
+		return type;
+	}
+
+	case Node::FUNCTION_TYPE: {
+		FunctionTypePtr type = arena().make<FunctionType>(location,
+			TypePtr(), FunctionType::ParameterTypeList());
+		type->returnType = readType(in);
+
+		const uint32_t count = in.next();
+		if (count > in.left()) throw Invalid();
+
+		type->parameterTypes.reserve(count);
+		for (uint32_t i = 0; i < count; ++i)
+			type->parameterTypes.push_back(readType(in));
+
+		module->types.adopt(type);
+
+		return type;
+	}
+
+	case Node::ARRAY_TYPE: {
+		ArrayTypePtr type = arena().make<ArrayType>(location, readType(in));
+		module->types.adopt(type);
+
+		return type;
+	}
+
+	case Node::BINARY_EXPR: {
+		const uint32_t operation = in.next();
+		if (operation > BinaryExpr::EQUALS) throw Invalid();
+
+		BinaryExprPtr binary = arena().make<BinaryExpr>(location,
+			static_cast<BinaryExpr::Operation>(operation),
+			ExprPtr(), ExprPtr());
+		binary->type = readType(in);
+		binary->left = child<Expr>(in);
+		binary->right = child<Expr>(in);
+
+		return binary;
+	}
+
+	case Node::LITERAL_NUMBER_EXPR: {
+		LiteralNumberExprPtr literal = arena().make<LiteralNumberExpr>(
+			location, static_cast<int_t>(unzigzag(in.varint())));
+		derivedTypes.push_back(literal);
+
+		return literal;
+	}
+
+	case Node::LITERAL_STRING_EXPR: {
+		const uint32_t length = in.next();
+		const char* text = in.take(length);
+
+		// The mapping goes away after reading
+		char* copy = context.literals.allocate(length);
+		if (length)
+			std::memcpy(copy, text, length);
+
+		StringLiteral value = { copy, length };
+		LiteralStringExprPtr literal =
+			arena().make<LiteralStringExpr>(location, value);
+		derivedTypes.push_back(literal);
+
+		return literal;
+	}
+
+	case Node::LITERAL_BOOL_EXPR: {
+		LiteralBoolExprPtr literal =
+			arena().make<LiteralBoolExpr>(location, in.next() != 0);
+		derivedTypes.push_back(literal);
+
+		return literal;
+	}
+
+	case Node::BLOCK_EXPR: {
+		BlockExprPtr block = arena().make<BlockExpr>(location,
+			BlockExpr::ExprList());
+		block->type = readType(in);
+		block->scope = beginScope(in);
+		readChildren<Expr>(in, block->exprs);
+		endScope(in, block->scope.get());
+
+		return block;
+	}
+
+	case Node::IF_ELSE_EXPR: {
+		IfElseExprPtr ifElse = arena().make<IfElseExpr>(location, ExprPtr(),
+			ExprPtr(), ExprPtr());
+		ifElse->type = readType(in);
+		ifElse->condition = child<Expr>(in);
+		ifElse->ifExpr = child<Expr>(in);
+		ifElse->elseExpr = child<Expr>(in);
+
+		return ifElse;
+	}
+
+	case Node::VOID_EXPR: {
+		VoidExprPtr voidExpr = arena().make<VoidExpr>(location);
+		derivedTypes.push_back(voidExpr);
+
+		return voidExpr;
+	}
+
+	case Node::IDENTIFIER_EXPR: {
+		IdentifierExprPtr identifier = arena().make<IdentifierExpr>(location,
+			this->identifier(in.next()));
+		identifier->type = readType(in);
+
+		return identifier;
+	}
+
+	case Node::CALL_EXPR: {
+		CallExprPtr call = arena().make<CallExpr>(location, ExprPtr(),
+			CallExpr::ArgumentList());
+		call->type = readType(in);
+		call->callee = child<Expr>(in);
+		readChildren<Expr>(in, call->arguments);
+
+		return call;
+	}
+
+	case Node::DECL_REF_EXPR: {
+		DeclRefExprPtr declRef = arena().make<DeclRefExpr>(location,
+			TypePtr(), DeclPtr());
+		readDecl(in, declRef->decl);
+		derivedTypes.push_back(declRef);
+
+		return declRef;
+	}
+
+	case Node::DECL_EXPR: {
+		DeclExprPtr declExpr = arena().make<DeclExpr>(location, DeclPtr());
+		declExpr->decl = child<Decl>(in);
+		derivedTypes.push_back(declExpr);
+
+		return declExpr;
+	}
+
+	case Node::DELAYED_EXPR: {
+		DelayedExprPtr delayed = arena().make<DelayedExpr>(location,
+			DeclPtr());
+		delayed->type = readType(in);
+		readDecl(in, delayed->delayedDecl);
+
+		return delayed;
+	}
+
+	case Node::ARRAY_ELEMENT_EXPR: {
+		ArrayElementExprPtr element = arena().make<ArrayElementExpr>(
+			location, ExprPtr(), ExprPtr());
+		element->type = readType(in);
+		element->array = child<Expr>(in);
+		element->index = child<Expr>(in);
+
+		return element;
+	}
+
+	case Node::IMPLICIT_CAST_EXPR: {
+		ImplicitCastExprPtr cast = arena().make<ImplicitCastExpr>(location,
+			TypePtr(), ExprPtr());
+		cast->type = readType(in);
+		cast->expr = child<Expr>(in);
+
+		return cast;
+	}
+
+	default:
+		throw Invalid();
+	}
+}
+
+void Reader::resolveDecls() {
+	for (auto it = fixups.begin(); it != fixups.end(); ++it) {
+		DeclPtr decl = decls[it->number - 1];
+		if (!decl) throw Invalid();
+
+		it->set(it->slot, decl);
+	}
+}
+
+// Sets the types Writer leaves out (see hasDerivedType) the way the
+// semantic phases do. At the end, so that the types that were written are
+// the module's ones already.
+void Reader::deriveTypes() {
+	TypeContext& types = module->types;
+
+	for (auto it = derivedTypes.begin(); it != derivedTypes.end(); ++it) {
+		ExprPtr expr = *it;
+
+		switch (expr->tag) {
+		case Node::LITERAL_NUMBER_EXPR:
+			expr->type = types.integral(IntegralType::I32);
+			break;
+
+		case Node::LITERAL_STRING_EXPR:
+			expr->type = types.array(types.integral(IntegralType::CHAR));
+			break;
+
+		case Node::LITERAL_BOOL_EXPR:
+			expr->type = types.integral(IntegralType::BOOL);
+			break;
+
+		case Node::VOID_EXPR:
+		case Node::DECL_EXPR:
+			expr->type = types.integral(IntegralType::VOID);
+			break;
+
+		case Node::DECL_REF_EXPR: {
+			DeclPtr decl = nodeCast<DeclRefExpr>(expr)->decl;
+
+			if (FunctionDeclPtr function = isA<FunctionDecl>(decl))
+				expr->type = function->type;
+			else if (VariableDeclPtr variable = isA<VariableDecl>(decl))
+				expr->type = variable->type;
+
+			break;
+		}
+
+		default:
+			assert(false);
+		}
+	}
+}
+
+// A read-only mapping of a whole file, empty if it can't be mapped
+class Mapping {
+public:
+	explicit Mapping(const std::string& path) : data(0), size(0) {
+		int fd = ::open(path.c_str(), O_RDONLY);
+		if (fd < 0) return;
+
+		struct stat info;
+		if (fstat(fd, &info) == 0 && info.st_size > 0) {
+			void* p = mmap(0, static_cast<size_t>(info.st_size), PROT_READ,
+			               MAP_PRIVATE, fd, 0);
+
+			if (p != MAP_FAILED) {
+				data = static_cast<const char*>(p);
+				size = static_cast<size_t>(info.st_size);
+			}
+		}
+
+		close(fd);
+	}
+
+	~Mapping() {
+		if (data)
+			munmap(const_cast<char*>(data), size);
+	}
+
+	const char* data;
+	size_t size;
+
+private:
+	Mapping(const Mapping&);
+	Mapping& operator=(const Mapping&);
+};
+
+} // namespace
+
+ModuleCache::ModuleCache(Context& context, SourceManager::FileId file)
+	: context(context), file(file),
+	  path_(context.sources.filename(file) + ".ast"),
+	  sourceHash(hash(context.sources.buffer(file).begin(),
+	                  context.sources.buffer(file).size())) {
+}
+
+ModulePtr ModuleCache::load() {
+	Mapping mapping(path_);
+	if (!mapping.data) {
+		LLANG_TRACE(CACHE, "no cache file %s", path_.c_str());
+		return 0;
+	}
+
+	try {
+		ModulePtr module = Reader(context, file, mapping.data, mapping.size)
+			.read(sourceHash);
+		LLANG_TRACE(CACHE, "loaded %s", path_.c_str());
+
+		return module;
+	} catch (const Invalid&) {
+		LLANG_TRACE(CACHE, "%s is out of date or damaged", path_.c_str());
+		return 0;
+	}
+}
+
+bool ModuleCache::store(Module& module) {
+	if (module.bodySource)
+		return false;
+
+	// Written under another name first, so that readers never see a file
+	// that is only partly written
+	const std::string temporary = path_ + ".tmp";
+
+	FILE* f = fopen(temporary.c_str(), "wb");
+	if (!f) return false;
+
+	Writer writer(context, file, f);
+	const bool written = writer.write(module, sourceHash);
+
+	if (fclose(f) != 0 || !written ||
+	    rename(temporary.c_str(), path_.c_str()) != 0) {
+		remove(temporary.c_str());
+		return false;
+	}
+
+	LLANG_TRACE(CACHE, "wrote %s, %llu bytes", path_.c_str(),
+	            static_cast<unsigned long long>(writer.size()));
+	return true;
+}
+
+} // namespace cache
+} // namespace llang
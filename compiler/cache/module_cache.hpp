@@ -0,0 +1,50 @@
+#ifndef LLANG_CACHE_MODULE_CACHE_HPP_INCLUDED
+#define LLANG_CACHE_MODULE_CACHE_HPP_INCLUDED
+
+#include <string>
+#include <stdint.h>
+
+#include "common/context.hpp"
+#include "common/source_manager.hpp"
+#include "ast/decl.hpp"
+
+namespace llang {
+namespace cache {
+
+// Keeps analyzed modules on disk next to their source file ("x.llang.ast"),
+// so that an unchanged file can go straight to codegen.
+//
+// The file holds the nodes' records in preorder, so that children need no
+// references, with all numbers as varints. It's written out while the tree
+// is walked. Reading maps the file and creates the nodes in the new
+// module's arena in one pass. The nodes themselves can't be mapped, as they
+// have vtables and own standard containers.
+//
+// A cache file is only used if it was written for the same contents of the
+// source (it keeps a hash of them) in the same format version.
+class ModuleCache {
+public:
+	// Hashes the file's contents
+	ModuleCache(Context& context, SourceManager::FileId file);
+
+	// Returns null if there is no usable cache for the file's contents
+	ast::ModulePtr load();
+
+	// Writes an analyzed module. Modules whose function bodies were skipped
+	// aren't cached. Returns false if nothing was written, which isn't an
+	// error: the next run analyzes the file again.
+	bool store(ast::Module& module);
+
+	const std::string& path() const { return path_; }
+
+private:
+	Context& context;
+	const SourceManager::FileId file;
+	const std::string path_;
+	const uint64_t sourceHash;
+};
+
+} // namespace cache
+} // namespace llang
+
+#endif
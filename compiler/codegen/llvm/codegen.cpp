@@ -8,9 +8,11 @@
 #include "llvm/Support/IRBuilder.h"
 #include "llvm/Analysis/Verifier.h"
 
+#include "common/trace_events.hpp"
 #include "ast/type.hpp"
 #include "ast/type_test.hpp"
 #include "ast/expr.hpp"
+#include "ast/node_count.hpp"
 #include "ast/visitor.hpp"
 #include "codegen/llvm/codegen.hpp"
 
@@ -206,10 +208,17 @@ protected:
 		// Need to save the insert point as we might already be generating
 		// a function right now!
 		SaveInsertPoint saveInsertPoint(builder);
+
+		// Never used (see Config::lazyFunctionBodies)
+		if (function->isBodySkipped()) return;
 		
 		// First check if we generated this function already
 		// (due to forward references)
-		if (module->getFunction(function->mangle())) return;
+		const std::string name = function->mangle(context.identifiers);
+		if (module->getFunction(name)) return;
+
+		trace::Span span("codegen", context.identifiers.c_str(function->name));
+		annotateSpan(span, context.sources, function);
 
 		// Check if we need to take a hidden context pointer
 		const llvm::Type* contextType = 0;
@@ -223,7 +232,7 @@ protected:
 			                contextType);
 		llvm::Function* f = Function::Create(type,
 		                                     Function::ExternalLinkage,
-		                                     function->mangle(),
+		                                     name,
 		                                     module);
 		
 		ScopeState::Function functionState;
@@ -241,7 +250,7 @@ protected:
 			for (; it2 != function->parameters.end(); ++it1, ++it2) {
 				// TODO: unnamed parameters?
 
-				it1->setName((*it2)->name);
+				it1->setName(context.identifiers.str((*it2)->name));
 				functionState.variables[*it2] = it1;
 			}
 		}
@@ -286,6 +295,7 @@ protected:
 		else
 			builder.CreateRetVoid();
 
+		trace::Span verifySpan("codegen", "verifyFunction");
 		llvm::verifyFunction(*f);
 	}
 
@@ -297,7 +307,8 @@ protected:
 		IRBuilder<> entryBuilder(&llvmFunction->getEntryBlock(),
 		                         llvmFunction->getEntryBlock().begin());
 		AllocaInst* alloca = entryBuilder.CreateAlloca(
-			accept(variable->type, state), 0, variable->name);
+			accept(variable->type, state), 0,
+			context.identifiers.str(variable->name));
 		assert(alloca);
 	
 		Value* init = accept(variable->initializer, state);
@@ -316,13 +327,15 @@ public:
 
 private:
 	Function* getFunction(FunctionDeclPtr function, ScopeState state) {
-		if (Function* llvmFunction = module->getFunction(function->mangle())) {
+		const std::string name = function->mangle(context.identifiers);
+
+		if (Function* llvmFunction = module->getFunction(name)) {
 			return llvmFunction;
 		}
 
 		accept(function, state);
 
-		Function* llvmFunction = module->getFunction(function->mangle());
+		Function* llvmFunction = module->getFunction(name);
 		assert(llvmFunction);
 
 		return llvmFunction;
@@ -338,7 +351,7 @@ protected:
 		else if (VariableDeclPtr decl =
 				isA<VariableDecl>(DeclPtr(expr->decl))) {
 			value = builder.CreateLoad(state.function->variables[decl],
-			                           decl->name);
+			                           context.identifiers.str(decl->name));
 		}
 		else if (FunctionDeclPtr decl =
 				isA<FunctionDecl>(DeclPtr(expr->decl))) {
@@ -426,10 +439,11 @@ protected:
 	}
 
 	virtual Value* visit(LiteralStringExprPtr expr, ScopeState state) {
-		size_t length = expr->string.size() + 1;
+		size_t length = expr->literal.length + 1;
 
 		const llvm::Type* elementType = IntegerType::get(llvmContext, 8);
-		llvm::StringRef string = StringRef(expr->string);
+		llvm::StringRef string = StringRef(expr->literal.data,
+		                                   expr->literal.length);
 
 		GlobalVariable* globalCharArray =
 			new GlobalVariable(*module,
@@ -7,7 +7,12 @@ namespace llang {
 
 // will later contain things like include paths
 struct Config {
+	Config() : lazyFunctionBodies(false) {}
 
+	// Skip the bodies of top-level functions when parsing, and only parse
+	// and analyze the ones that are used, starting from main. Errors in
+	// the others are not reported.
+	bool lazyFunctionBodies;
 };
 
 } // namespace llang
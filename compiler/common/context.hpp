@@ -3,19 +3,25 @@
 
 #include "common/config.hpp"
 #include "common/diagnostics.hpp"
+#include "common/interner.hpp"
+#include "common/literal_pool.hpp"
+#include "common/source_manager.hpp"
 
 namespace llang {
 
 struct Context {
-	Context(const Config& config, Diagnostics& diag)
-		: config(config), diag(diag) {
+	Context(const Config& config, Diagnostics& diag, SourceManager& sources)
+		: config(config), diag(diag), sources(sources) {
 	}
 
 	const Config& config;
 	Diagnostics& diag;
+	SourceManager& sources;
+
+	Interner identifiers;
+	LiteralPool literals;
 };
 
 } // namespace llang
 
 #endif
-
@@ -1,5 +1,6 @@
 #include <cstdio>
 #include <iostream>
+#include <sstream>
 #include <stdexcept>
 
 #include "common/diagnostics.hpp"
@@ -7,13 +8,24 @@
 namespace llang {
 
 void Diagnostics::verror(const Location& location, const char* format, va_list argp) {
-	std::cout << location << ": error: " << std::flush;
+	char message[512];
+	vsnprintf(message, sizeof(message), format, argp);
 
-	vfprintf(stderr, format, argp);
-	fprintf(stderr, "\n");
+	// Without the location, decoding it isn't safe on the threads that
+	// use quiet instances
+	if (quiet)
+		throw std::runtime_error(message);
+
+	std::cout << sources.decode(location) << ": error: " << std::flush;
+	fprintf(stderr, "%s\n", message);
+
+	// The exception carries the whole diagnostic, for callers that don't
+	// see stderr
+	std::ostringstream text;
+	text << sources.decode(location) << ": error: " << message;
 
 	// TODO: throw something else
-	throw std::runtime_error("error");
+	throw std::runtime_error(text.str());
 }
 
 void Diagnostics::error(const Location& location, const char* format, ...) {
@@ -5,15 +5,25 @@
 #include <cstdarg>
 #include "common/location.hpp"
 #include "common/config.hpp"
+#include "common/source_manager.hpp"
 
 namespace llang {
 
 class Diagnostics {
 public:
-	Diagnostics(Config&) {}
+	// A quiet instance doesn't print errors, they only throw. For work that
+	// is redone if it fails (see ParallelParser).
+	Diagnostics(const Config&, const SourceManager& sources,
+	            bool quiet = false)
+		: sources(sources), quiet(quiet) {
+	}
 
 	void verror(const Location& location, const char* format, va_list argp);
 	void error(const Location& location, const char* format, ...);
+
+private:
+	const SourceManager& sources;
+	const bool quiet;
 };
 
 } // namespace llang
@@ -1,11 +1,38 @@
 #ifndef LLANG_COMMON_IDENTIFIER_HPP_INCLUDED
 #define LLANG_COMMON_IDENTIFIER_HPP_INCLUDED
 
-#include <string>
+#include <cstddef>
+#include <stdint.h>
 
 namespace llang {
 
-typedef std::string identifier_t;
+// An interned name, handed out by Interner. Comparing and hashing
+// identifiers are integer operations; use the interner to get at the text.
+class Identifier {
+public:
+	// The empty identifier
+	Identifier() : id_(0) {}
+
+	explicit Identifier(uint32_t id) : id_(id) {}
+
+	uint32_t id() const { return id_; }
+	bool empty() const { return id_ == 0; }
+
+	bool operator==(Identifier other) const { return id_ == other.id_; }
+	bool operator!=(Identifier other) const { return id_ != other.id_; }
+	bool operator<(Identifier other) const { return id_ < other.id_; }
+
+private:
+	uint32_t id_;
+};
+
+struct IdentifierHash {
+	size_t operator()(Identifier identifier) const {
+		return identifier.id();
+	}
+};
+
+typedef Identifier identifier_t;
 
 } // namespace llang
 
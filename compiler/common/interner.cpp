@@ -0,0 +1,73 @@
+#include <cstring>
+
+#include "common/interner.hpp"
+
+namespace llang {
+
+namespace {
+
+// FNV-1a
+uint32_t hash(const char* start, size_t length) {
+	uint32_t h = 2166136261u;
+
+	for (size_t i = 0; i < length; ++i) {
+		h ^= static_cast<unsigned char>(start[i]);
+		h *= 16777619u;
+	}
+
+	return h;
+}
+
+} // namespace
+
+Interner::Interner()
+	: slots(256, 0) {
+	// Identifier 0 is the empty name
+	strings.push_back(std::string());
+	hashes.push_back(hash("", 0));
+	slots[hashes[0] & (slots.size() - 1)] = 1;
+}
+
+identifier_t Interner::intern(const char* start, size_t length) {
+	const uint32_t h = hash(start, length);
+	const size_t mask = slots.size() - 1;
+
+	size_t slot = h & mask;
+	while (uint32_t entry = slots[slot]) {
+		const uint32_t id = entry - 1;
+		const std::string& string = strings[id];
+
+		if (hashes[id] == h && string.size() == length &&
+		    memcmp(string.data(), start, length) == 0)
+			return identifier_t(id);
+
+		slot = (slot + 1) & mask;
+	}
+
+	const uint32_t id = static_cast<uint32_t>(strings.size());
+	strings.push_back(std::string(start, length));
+	hashes.push_back(h);
+	slots[slot] = id + 1;
+
+	// Keep the load factor below 1/2
+	if (strings.size() * 2 > slots.size())
+		grow();
+
+	return identifier_t(id);
+}
+
+void Interner::grow() {
+	std::vector<uint32_t> newSlots(slots.size() * 2, 0);
+	const size_t mask = newSlots.size() - 1;
+
+	for (uint32_t id = 0; id < strings.size(); ++id) {
+		size_t slot = hashes[id] & mask;
+		while (newSlots[slot]) slot = (slot + 1) & mask;
+
+		newSlots[slot] = id + 1;
+	}
+
+	slots.swap(newSlots);
+}
+
+} // namespace llang
@@ -0,0 +1,49 @@
+#ifndef LLANG_COMMON_INTERNER_HPP_INCLUDED
+#define LLANG_COMMON_INTERNER_HPP_INCLUDED
+
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "common/identifier.hpp"
+
+namespace llang {
+
+// Maps names to compact identifiers. Every distinct name is stored once and
+// lives as long as the interner.
+class Interner {
+public:
+	Interner();
+
+	identifier_t intern(const char* start, size_t length);
+
+	identifier_t intern(const std::string& string) {
+		return intern(string.data(), string.size());
+	}
+
+	const std::string& str(identifier_t identifier) const {
+		return strings[identifier.id()];
+	}
+
+	const char* c_str(identifier_t identifier) const {
+		return str(identifier).c_str();
+	}
+
+	size_t size() const { return strings.size(); }
+
+private:
+	Interner(const Interner&);
+	Interner& operator=(const Interner&);
+
+	void grow();
+
+	std::deque<std::string> strings; // indexed by identifier
+	std::vector<uint32_t> hashes; // indexed by identifier
+
+	// Open addressing, contains identifier + 1 or 0 for empty slots
+	std::vector<uint32_t> slots;
+};
+
+} // namespace llang
+
+#endif
@@ -0,0 +1,36 @@
+#include "common/literal_pool.hpp"
+
+namespace llang {
+
+LiteralPool::LiteralPool()
+	: next(0), end(0) {
+}
+
+LiteralPool::~LiteralPool() {
+	for (size_t i = 0; i < blocks.size(); ++i)
+		delete[] blocks[i];
+}
+
+char* LiteralPool::allocate(size_t length) {
+	std::lock_guard<std::mutex> lock(mutex);
+
+	if (static_cast<size_t>(end - next) >= length) {
+		char* result = next;
+		next += length;
+		return result;
+	}
+
+	// Big literals get a block of their own, the current one stays in use
+	if (length > blockSize / 4) {
+		blocks.push_back(new char[length]);
+		return blocks.back();
+	}
+
+	blocks.push_back(new char[blockSize]);
+	next = blocks.back() + length;
+	end = blocks.back() + blockSize;
+
+	return blocks.back();
+}
+
+} // namespace llang
@@ -0,0 +1,43 @@
+#ifndef LLANG_COMMON_LITERAL_POOL_HPP_INCLUDED
+#define LLANG_COMMON_LITERAL_POOL_HPP_INCLUDED
+
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+namespace llang {
+
+// Contents of a string literal, not null-terminated. Points either into the
+// source buffer or into a LiteralPool.
+struct StringLiteral {
+	const char* data;
+	size_t length;
+};
+
+// Storage for string literals that had to be decoded because they contain
+// escape sequences. Memory is handed out from large blocks and lives as long
+// as the pool. Can be used from several threads.
+class LiteralPool {
+public:
+	LiteralPool();
+	~LiteralPool();
+
+	// Returns room for length bytes
+	char* allocate(size_t length);
+
+private:
+	LiteralPool(const LiteralPool&);
+	LiteralPool& operator=(const LiteralPool&);
+
+	static const size_t blockSize = 64 * 1024;
+
+	std::vector<char*> blocks;
+	char* next; // free space in the last block
+	char* end;
+
+	std::mutex mutex;
+};
+
+} // namespace llang
+
+#endif
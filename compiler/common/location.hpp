@@ -1,26 +1,21 @@
 #ifndef LLANG_COMMON_LOCATION_HPP_INCLUDED
 #define LLANG_COMMON_LOCATION_HPP_INCLUDED
 
-#include <iostream>
-#include <string>
+#include <stdint.h>
 
 namespace llang {
 
+// A position in one of the files registered with the SourceManager, encoded
+// as an offset into the concatenation of all files. Use the SourceManager
+// to decode it into a file, line and column.
 struct Location {
-	const std::string filename;
-	const size_t line;
-	const size_t column;
+	uint32_t offset; // 0 is not a valid location
 
-	Location(const std::string& filename, size_t line, size_t column)
-		: filename(filename), line(line), column(column) {
-	}
-};
+	Location() : offset(0) {}
+	explicit Location(uint32_t offset) : offset(offset) {}
 
-inline std::ostream& operator<<(std::ostream& os, const Location& location) {
-	os << location.filename << ":" << location.line
-	   << ":" << location.column;
-	return os;
-}
+	bool isValid() const { return offset != 0; }
+};
 
 } // namespace llang
 
@@ -0,0 +1,154 @@
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+#include "util/scan.hpp"
+#include "common/piece_table.hpp"
+
+namespace llang {
+
+PieceTable::PieceTable(const char* data, size_t size)
+	: size_(size), next(0), end(0) {
+	if (size) {
+		Piece piece = { 0, data, size };
+		pieces.push_back(piece);
+	}
+}
+
+PieceTable::~PieceTable() {
+	for (size_t i = 0; i < blocks.size(); ++i)
+		delete[] blocks[i];
+}
+
+void PieceTable::replace(size_t offset, size_t removed, const char* inserted,
+                         size_t length) {
+	assert(offset + removed <= size_);
+
+	const char* stored = length ? append(inserted, length) : 0;
+
+	// Typing: the bytes follow the last insertion both in the text and in
+	// the block
+	if (!removed && length && offset > 0) {
+		size_t i = find(offset - 1);
+		Piece& piece = pieces[i];
+
+		if (piece.start + piece.length == offset &&
+		    piece.data + piece.length == stored) {
+			piece.length += length;
+			for (++i; i < pieces.size(); ++i)
+				pieces[i].start += length;
+
+			size_ += length;
+			return;
+		}
+	}
+
+	size_t first = split(offset);
+	const size_t last = split(offset + removed);
+	pieces.erase(pieces.begin() + first, pieces.begin() + last);
+
+	if (length) {
+		Piece piece = { offset, stored, length };
+		pieces.insert(pieces.begin() + first, piece);
+		++first;
+	}
+
+	for (size_t i = first; i < pieces.size(); ++i)
+		pieces[i].start = pieces[i].start - removed + length;
+
+	size_ = size_ - removed + length;
+}
+
+void PieceTable::copy(size_t offset, size_t length, char* out) const {
+	assert(offset + length <= size_);
+	if (!length) return;
+
+	for (size_t i = find(offset); length; ++i) {
+		const Piece& piece = pieces[i];
+		const size_t skip = offset - piece.start;
+		const size_t n = std::min(piece.length - skip, length);
+
+		memcpy(out, piece.data + skip, n);
+		out += n;
+		offset += n;
+		length -= n;
+	}
+}
+
+void PieceTable::findLineStarts(std::vector<uint32_t>& out) const {
+	// TODO: CRLF
+	out.assign(1, 0);
+
+	for (size_t i = 0; i < pieces.size(); ++i) {
+		const char* begin = pieces[i].data;
+		const char* end = begin + pieces[i].length;
+
+		const size_t first = out.size();
+		out.resize(first + scan::countNewlines(begin, end));
+		if (out.size() == first) continue;
+
+		// Lines start after the newlines
+		scan::findNewlines(begin, end, &out[first]);
+		const uint32_t start = static_cast<uint32_t>(pieces[i].start) + 1;
+		for (size_t j = first; j < out.size(); ++j)
+			out[j] += start;
+	}
+}
+
+size_t PieceTable::find(size_t offset) const {
+	assert(!pieces.empty() && offset < size_);
+
+	// The last piece starting at or before offset
+	size_t low = 0, high = pieces.size();
+	while (high - low > 1) {
+		size_t middle = (low + high) / 2;
+
+		if (pieces[middle].start <= offset)
+			low = middle;
+		else
+			high = middle;
+	}
+
+	return low;
+}
+
+size_t PieceTable::split(size_t offset) {
+	if (offset == size_)
+		return pieces.size();
+
+	const size_t i = find(offset);
+	Piece& piece = pieces[i];
+	if (piece.start == offset)
+		return i;
+
+	const size_t skip = offset - piece.start;
+	Piece second = { offset, piece.data + skip, piece.length - skip };
+	piece.length = skip;
+
+	pieces.insert(pieces.begin() + i + 1, second);
+	return i + 1;
+}
+
+const char* PieceTable::append(const char* data, size_t length) {
+	char* out;
+
+	if (static_cast<size_t>(end - next) >= length) {
+		out = next;
+		next += length;
+	} else if (length > blockSize / 4) {
+		// Big insertions get a block of their own, the current one stays in
+		// use
+		blocks.push_back(new char[length]);
+		out = blocks.back();
+	} else {
+		blocks.push_back(new char[blockSize]);
+		out = blocks.back();
+		next = out + length;
+		end = out + blockSize;
+	}
+
+	memcpy(out, data, length);
+	return out;
+}
+
+} // namespace llang
@@ -0,0 +1,63 @@
+#ifndef LLANG_COMMON_PIECE_TABLE_HPP_INCLUDED
+#define LLANG_COMMON_PIECE_TABLE_HPP_INCLUDED
+
+#include <stdint.h>
+#include <vector>
+
+namespace llang {
+
+// The text of a file that is being edited, as a sequence of pieces of
+// memory that never changes: the original buffer and blocks the inserted
+// bytes are appended to. An edit only copies the bytes it inserts and
+// splits at most two pieces, so it doesn't get slower with the size of the
+// file. Typing at one place keeps extending the same piece.
+class PieceTable {
+public:
+	// The original text isn't copied, it must outlive the table
+	PieceTable(const char* data, size_t size);
+	~PieceTable();
+
+	size_t size() const { return size_; }
+
+	// Replaces [offset, offset + removed) with the given bytes
+	void replace(size_t offset, size_t removed, const char* inserted,
+	             size_t length);
+
+	// Copies [offset, offset + length) to out
+	void copy(size_t offset, size_t length, char* out) const;
+
+	// Offsets at which lines start, see SourceManager
+	void findLineStarts(std::vector<uint32_t>& out) const;
+
+private:
+	PieceTable(const PieceTable&);
+	PieceTable& operator=(const PieceTable&);
+
+	struct Piece {
+		size_t start; // offset in the text
+		const char* data;
+		size_t length;
+	};
+
+	// Index of the piece containing offset, or of the one starting there
+	size_t find(size_t offset) const;
+
+	// Makes a piece start at offset, returning its index
+	size_t split(size_t offset);
+
+	// Stores the bytes for good
+	const char* append(const char* data, size_t length);
+
+	std::vector<Piece> pieces;
+	size_t size_;
+
+	// Inserted bytes, like in LiteralPool
+	std::vector<char*> blocks;
+	char* next;
+	char* end;
+	static const size_t blockSize = 64 * 1024;
+};
+
+} // namespace llang
+
+#endif
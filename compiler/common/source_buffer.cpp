@@ -0,0 +1,117 @@
+#include <stdexcept>
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "common/piece_table.hpp"
+#include "common/source_buffer.hpp"
+
+namespace llang {
+
+SourceBuffer::SourceBuffer(const std::string& filename)
+	: data(0), size_(0), mappedSize(0) {
+	if (filename == "-") {
+		read(STDIN_FILENO, filename);
+		return;
+	}
+
+	int fd = ::open(filename.c_str(), O_RDONLY);
+	if (fd < 0)
+		throw std::runtime_error("couldn't read file " + filename);
+
+	struct stat info;
+	if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0) {
+		size_t size = static_cast<size_t>(info.st_size);
+		size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+
+		// The kernel zero-fills the rest of the last page, which gives us
+		// the padding for free - unless the file ends too close to a page
+		// boundary.
+		size_t tail = (pageSize - size % pageSize) % pageSize;
+
+		if (tail >= padding) {
+			size_t length = size + tail;
+			void* p = mmap(0, length, PROT_READ, MAP_PRIVATE, fd, 0);
+
+			if (p != MAP_FAILED) {
+				madvise(p, length, MADV_SEQUENTIAL);
+
+				data = static_cast<const char*>(p);
+				size_ = size;
+				mappedSize = length;
+
+				close(fd);
+				return;
+			}
+		}
+
+		// Room for the contents, the padding and the final empty read
+		storage.reserve(size + padding);
+	}
+
+	try {
+		read(fd, filename);
+	} catch (...) {
+		close(fd);
+		throw;
+	}
+
+	close(fd);
+}
+
+SourceBuffer::SourceBuffer(const char* source, size_t size)
+	: data(0), size_(size), mappedSize(0) {
+	storage.reserve(size + padding);
+	storage.assign(source, source + size);
+	storage.resize(size + padding, '\0');
+	data = &storage[0];
+}
+
+SourceBuffer::SourceBuffer(const PieceTable& text, size_t offset,
+                           size_t length)
+	: data(0), size_(length), mappedSize(0) {
+	storage.resize(length + padding, '\0');
+	text.copy(offset, length, &storage[0]);
+	data = &storage[0];
+}
+
+SourceBuffer::~SourceBuffer() {
+	if (mappedSize)
+		munmap(const_cast<char*>(data), mappedSize);
+}
+
+void SourceBuffer::read(int fd, const std::string& filename) {
+	const size_t chunkSize = 64 * 1024;
+
+	for (;;) {
+		size_t used = storage.size();
+		size_t room = storage.capacity() - used > 1 ?
+			storage.capacity() - used - 1 : chunkSize;
+		storage.resize(used + room);
+
+		ssize_t n = ::read(fd, &storage[used], room);
+
+		if (n < 0) {
+			if (errno == EINTR) {
+				storage.resize(used);
+				continue;
+			}
+
+			throw std::runtime_error("couldn't read file " + filename + ": " +
+			                         strerror(errno));
+		}
+
+		storage.resize(used + static_cast<size_t>(n));
+		if (n == 0) break;
+	}
+
+	size_ = storage.size();
+	storage.resize(size_ + padding, '\0');
+	data = &storage[0];
+}
+
+} // namespace llang
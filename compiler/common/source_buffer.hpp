@@ -0,0 +1,54 @@
+#ifndef LLANG_COMMON_SOURCE_BUFFER_HPP_INCLUDED
+#define LLANG_COMMON_SOURCE_BUFFER_HPP_INCLUDED
+
+#include <string>
+#include <vector>
+
+namespace llang {
+
+class PieceTable;
+
+// Read-only view of a source file. The contents are always followed by a
+// '\0' byte, so the lexer can scan the buffer in place without bounds checks.
+//
+// Regular files are memory-mapped where possible. Pipes, stdin ("-") and
+// files whose size leaves no room for the padding in the last page are
+// read into a heap buffer instead.
+class SourceBuffer {
+public:
+	// Number of zero bytes following the contents, starting with the '\0'.
+	// This allows the lexer to look a few bytes ahead near the end.
+	static const size_t padding = 32;
+
+	explicit SourceBuffer(const std::string& filename);
+
+	// Copies the given memory (used for sources that don't come from a file)
+	SourceBuffer(const char* data, size_t size);
+
+	// Copies [offset, offset + length) of an edited file
+	SourceBuffer(const PieceTable& text, size_t offset, size_t length);
+
+	~SourceBuffer();
+
+	const char* begin() const { return data; }
+	const char* end() const { return data + size_; }
+	size_t size() const { return size_; }
+
+	bool isMapped() const { return mappedSize != 0; }
+
+private:
+	SourceBuffer(const SourceBuffer&);
+	SourceBuffer& operator=(const SourceBuffer&);
+
+	void read(int fd, const std::string& filename);
+
+	const char* data;
+	size_t size_;
+
+	size_t mappedSize; // 0 if not mapped
+	std::vector<char> storage; // used if not mapped
+};
+
+} // namespace llang
+
+#endif
@@ -0,0 +1,293 @@
+#include <algorithm>
+#include <cassert>
+#include <limits>
+#include <stdexcept>
+
+#include "util/scan.hpp"
+#include "common/source_manager.hpp"
+
+namespace llang {
+
+std::ostream& operator<<(std::ostream& os, const PresumedLocation& location) {
+	if (!location.filename)
+		return os << "<unknown>";
+
+	os << *location.filename << ":" << location.line
+	   << ":" << location.column;
+	return os;
+}
+
+SourceManager::SourceManager()
+	: nextBase(1) { // offset 0 is reserved for invalid locations
+}
+
+SourceManager::~SourceManager() {
+	for (size_t i = 0; i < files.size(); ++i)
+		delete files[i];
+
+	for (size_t i = 0; i < documents.size(); ++i)
+		delete documents[i];
+}
+
+SourceManager::FileId SourceManager::addFile(const std::string& filename,
+                                             SourceBuffer* buffer) {
+	scoped_ptr<SourceBuffer> owned(buffer);
+	const uint32_t base = allocate(buffer->size(), filename);
+
+	Document* document = new Document;
+	document->filename = filename;
+	document->buffer.swap(owned);
+	documents.push_back(document);
+
+	File* file = new File;
+	file->id = static_cast<FileId>(files.size());
+	file->document = document;
+	file->windowStart = 0;
+	file->size = static_cast<uint32_t>(buffer->size());
+	file->base = base;
+	file->previous = file->next = 0;
+	files.push_back(file);
+	ranges.push_back(file);
+
+	return file->id;
+}
+
+SourceManager::FileId SourceManager::addVersion(FileId previous,
+                                                size_t offset, size_t removed,
+                                                const char* inserted,
+                                                size_t length) {
+	File& old = *files[previous];
+	assert(!old.next && offset + removed <= old.size);
+
+	Document& document = *old.document;
+	if (!document.text) {
+		document.text.reset(new PieceTable(document.buffer->begin(),
+		                                   document.buffer->size()));
+	}
+
+	document.text->replace(offset, removed, inserted, length);
+
+	File* file = new File;
+	file->id = static_cast<FileId>(files.size());
+	file->document = &document;
+	file->windowStart = 0;
+	file->base = nextBase;
+	file->size = static_cast<uint32_t>(document.text->size());
+	file->previous = &old;
+	file->next = 0;
+	files.push_back(file);
+
+	old.next = file;
+	addShift(old.shifts, 0, 0, false);
+	if (removed > 1) {
+		addShift(old.shifts, static_cast<uint32_t>(offset + 1),
+		         static_cast<uint32_t>(offset), true);
+	}
+	addShift(old.shifts, static_cast<uint32_t>(offset + removed),
+	         static_cast<uint32_t>(offset + length), false);
+
+	// Only the newest version is decoded into lines
+	std::vector<uint32_t>().swap(old.lineStarts);
+
+	return file->id;
+}
+
+void SourceManager::setWindow(FileId version, size_t start, size_t end) {
+	File& file = *files[version];
+	const PieceTable& text = *file.document->text;
+	assert(!file.next && start <= end && end <= text.size());
+
+	if (file.window) {
+		// Grow the range at the end of the location space
+		assert(start == file.windowStart && ranges.back() == &file &&
+		       file.base + file.window->size() + 1 == nextBase);
+		nextBase = file.base;
+		file.base = allocate(end - start, file.document->filename);
+	} else {
+		file.base = allocate(end - start, file.document->filename);
+		ranges.push_back(&file);
+	}
+
+	file.window.reset(new SourceBuffer(text, start, end - start));
+	file.windowStart = static_cast<uint32_t>(start);
+}
+
+void SourceManager::release(FileId version) {
+	File* file = files[version];
+	assert(file && file->next);
+
+	File* previous = file->previous;
+	if (previous) {
+		ShiftList shifts;
+		compose(previous->shifts, previous->size, file->shifts, file->size,
+		        shifts);
+		previous->shifts.swap(shifts);
+		previous->next = file->next;
+	}
+
+	file->next->previous = previous;
+
+	// Versions that never got a window have no range
+	for (size_t low = 0, high = ranges.size(); low < high;) {
+		size_t middle = (low + high) / 2;
+
+		if (ranges[middle] == file) {
+			ranges.erase(ranges.begin() + middle);
+			break;
+		} else if (ranges[middle]->base < file->base) {
+			low = middle + 1;
+		} else {
+			high = middle;
+		}
+	}
+
+	files[version] = 0;
+	delete file;
+}
+
+SourceManager::FileId SourceManager::fileOf(Location location) const {
+	assert(location.isValid() && location.offset < nextBase);
+
+	// The last file starting before location
+	size_t low = 0, high = ranges.size();
+	while (high - low > 1) {
+		size_t middle = (low + high) / 2;
+
+		if (ranges[middle]->base <= location.offset)
+			low = middle;
+		else
+			high = middle;
+	}
+
+	return ranges[low]->id;
+}
+
+// Where the offset ends up in the next version
+uint32_t SourceManager::shift(const ShiftList& shifts, uint32_t offset) {
+	// The last shift starting at or before offset
+	size_t low = 0, high = shifts.size();
+	while (high - low > 1) {
+		size_t middle = (low + high) / 2;
+
+		if (shifts[middle].from <= offset)
+			low = middle;
+		else
+			high = middle;
+	}
+
+	const Shift& s = shifts[low];
+	return s.collapsed ? s.to : s.to + (offset - s.from);
+}
+
+// Appends a shift unless it continues the last one
+void SourceManager::addShift(ShiftList& shifts, uint32_t from, uint32_t to,
+                             bool collapsed) {
+	if (!shifts.empty()) {
+		const Shift& last = shifts.back();
+
+		if (collapsed ? last.collapsed && last.to == to :
+		    !last.collapsed && to + last.from == last.to + from)
+			return;
+	}
+
+	Shift s = { from, to, collapsed };
+	shifts.push_back(s);
+}
+
+// The shifts of two consecutive versions as one. Sizes are those of the
+// versions the shifts start in.
+void SourceManager::compose(const ShiftList& first, uint32_t firstSize,
+                            const ShiftList& second, uint32_t secondSize,
+                            ShiftList& out) {
+	ShiftList::const_iterator next = second.begin();
+
+	for (size_t i = 0; i < first.size(); ++i) {
+		const Shift& a = first[i];
+
+		if (a.collapsed) {
+			addShift(out, a.from, shift(second, a.to), true);
+			continue;
+		}
+
+		// Where the offsets of a end up in the middle version
+		const uint32_t from = a.to;
+		const uint32_t to = a.to + ((i + 1 < first.size() ?
+			first[i + 1].from : firstSize + 1) - a.from);
+
+		// Each shift of the middle version that overlaps them
+		while (next + 1 != second.end() && (next + 1)->from <= from)
+			++next;
+
+		for (ShiftList::const_iterator b = next; b != second.end(); ++b) {
+			const uint32_t bEnd = b + 1 != second.end() ?
+				(b + 1)->from : secondSize + 1;
+			const uint32_t low = std::max(from, b->from);
+			if (low >= std::min(to, bEnd)) break;
+
+			addShift(out, a.from + (low - from),
+			         b->collapsed ? b->to : b->to + (low - b->from),
+			         b->collapsed);
+		}
+	}
+}
+
+const std::vector<uint32_t>& SourceManager::lineStarts(const File& file) const {
+	if (!file.lineStarts.empty())
+		return file.lineStarts;
+
+	std::vector<uint32_t>& starts = file.lineStarts;
+
+	if (file.document->text) {
+		file.document->text->findLineStarts(starts);
+		return starts;
+	}
+
+	const char* begin = file.document->buffer->begin();
+	const char* end = file.document->buffer->end();
+
+	// TODO: CRLF
+	starts.resize(scan::countNewlines(begin, end) + 1);
+	starts[0] = 0;
+
+	// Lines start after the newlines
+	scan::findNewlines(begin, end, &starts[1]);
+	for (size_t i = 1; i < starts.size(); ++i)
+		++starts[i];
+
+	return starts;
+}
+
+PresumedLocation SourceManager::decode(Location location) const {
+	PresumedLocation result = { 0, 0, 0 };
+	if (!location.isValid()) return result;
+
+	const File* file = files[fileOf(location)];
+	uint32_t offset = location.offset - file->base + file->windowStart;
+
+	// Follow the edits to the newest version
+	for (; file->next; file = file->next)
+		offset = shift(file->shifts, offset);
+
+	const std::vector<uint32_t>& starts = lineStarts(*file);
+	size_t line = static_cast<size_t>(
+		std::upper_bound(starts.begin(), starts.end(), offset) -
+		starts.begin());
+
+	result.filename = &file->document->filename;
+	result.line = line;
+	result.column = offset - starts[line - 1] + 1;
+
+	return result;
+}
+
+// Reserves locations for size bytes and the end
+uint32_t SourceManager::allocate(size_t size, const std::string& filename) {
+	if (size + 1 > std::numeric_limits<uint32_t>::max() - nextBase)
+		throw std::runtime_error("too much source code: " + filename);
+
+	const uint32_t base = nextBase;
+	nextBase += static_cast<uint32_t>(size + 1);
+	return base;
+}
+
+} // namespace llang
@@ -0,0 +1,172 @@
+#ifndef LLANG_COMMON_SOURCE_MANAGER_HPP_INCLUDED
+#define LLANG_COMMON_SOURCE_MANAGER_HPP_INCLUDED
+
+#include <cassert>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "util/smart_ptr.hpp"
+#include "common/location.hpp"
+#include "common/piece_table.hpp"
+#include "common/source_buffer.hpp"
+
+namespace llang {
+
+// A Location decoded for printing
+struct PresumedLocation {
+	const std::string* filename; // null for invalid locations
+	size_t line;
+	size_t column;
+};
+
+std::ostream& operator<<(std::ostream& os, const PresumedLocation& location);
+
+// Owns the source buffers and hands out the offset ranges Locations are
+// encoded in. Line tables are only built once a location in the file
+// actually needs to be decoded.
+//
+// Files that are being edited (see addVersion) get a new FileId per
+// version. Only the newest version has its text, as a PieceTable, and only
+// the part of it that is lexed again (its window) gets a buffer and
+// locations. Older versions keep their window and map their offsets to the
+// next version, until they are released.
+class SourceManager {
+public:
+	typedef uint32_t FileId;
+
+	SourceManager();
+	~SourceManager();
+
+	// Takes ownership of the buffer
+	FileId addFile(const std::string& filename, SourceBuffer* buffer);
+
+	FileId loadFile(const std::string& filename) {
+		return addFile(filename, new SourceBuffer(filename));
+	}
+
+	// Adds the next version of a file, which differs from the newest one by
+	// replacing [offset, offset + removed) with the inserted bytes. Only
+	// those are copied. Locations in older versions stay valid, they decode
+	// to the same text in the newest version (or to the start of the edit if
+	// it replaced them).
+	//
+	// The version has no buffer and no locations until setWindow.
+	FileId addVersion(FileId previous, size_t offset, size_t removed,
+	                  const char* inserted, size_t length);
+
+	// Copies [start, end) of the newest version into its buffer and gives
+	// these bytes (and end) locations. The window can be grown by calling
+	// this again with the same start, as long as no other file got
+	// locations in between; locations handed out before stay valid.
+	void setWindow(FileId version, size_t start, size_t end);
+
+	// Drops a version no location of which will be decoded again: its buffer
+	// goes away and its edit is merged into the previous version's. Not for
+	// the newest version.
+	void release(FileId version);
+
+	// The whole file, or the window of a version
+	const SourceBuffer& buffer(FileId file) const {
+		const File& f = *files[file];
+		assert(f.window || !f.document->text);
+		return f.window ? *f.window : *f.document->buffer;
+	}
+
+	// Offset of the buffer's first byte in the file
+	size_t bufferOffset(FileId file) const {
+		return files[file]->windowStart;
+	}
+
+	// Size of the whole file (which the buffer might only be a part of)
+	size_t size(FileId file) const {
+		return files[file]->size;
+	}
+
+	const std::string& filename(FileId file) const {
+		return files[file]->document->filename;
+	}
+
+	// Location of the given byte in the file, which must be in its buffer
+	Location location(FileId file, size_t offset) const {
+		const File& f = *files[file];
+		assert(offset >= f.windowStart &&
+		       offset <= f.windowStart + buffer(file).size());
+		return Location(f.base + static_cast<uint32_t>(offset - f.windowStart));
+	}
+
+	FileId fileOf(Location location) const;
+
+	// Byte offset of the location in its file
+	size_t offsetOf(Location location) const {
+		const File& f = *files[fileOf(location)];
+		return location.offset - f.base + f.windowStart;
+	}
+
+	// Decodes the location in the newest version of its file
+	PresumedLocation decode(Location location) const;
+
+private:
+	SourceManager(const SourceManager&);
+	SourceManager& operator=(const SourceManager&);
+
+	// Offsets from `from` on end up at `to` on in the next version, or all
+	// at `to` if an edit removed them
+	struct Shift {
+		uint32_t from, to;
+		bool collapsed;
+	};
+
+	typedef std::vector<Shift> ShiftList;
+
+	// A file with all its versions
+	struct Document {
+		std::string filename;
+		scoped_ptr<SourceBuffer> buffer;
+		scoped_ptr<PieceTable> text; // once it is edited
+	};
+
+	struct File {
+		FileId id;
+		Document* document;
+
+		// Versions only
+		scoped_ptr<SourceBuffer> window;
+		uint32_t windowStart;
+
+		uint32_t base; // location of the window's first byte
+		uint32_t size;
+
+		// The neighbouring versions that aren't released, and the edits
+		// that lead to the next one
+		File* previous;
+		File* next;
+		ShiftList shifts;
+
+		// Offsets at which lines start in the newest version, built on first
+		// use
+		mutable std::vector<uint32_t> lineStarts;
+	};
+
+	static uint32_t shift(const ShiftList& shifts, uint32_t offset);
+	static void addShift(ShiftList& shifts, uint32_t from, uint32_t to,
+	                     bool collapsed);
+	static void compose(const ShiftList& first, uint32_t firstSize,
+	                    const ShiftList& second, uint32_t secondSize,
+	                    ShiftList& out);
+
+	const std::vector<uint32_t>& lineStarts(const File& file) const;
+
+	uint32_t allocate(size_t size, const std::string& filename);
+
+	std::vector<Document*> documents;
+	std::vector<File*> files; // null once released
+
+	// Files with locations, sorted by base
+	std::vector<File*> ranges;
+	uint32_t nextBase;
+};
+
+} // namespace llang
+
+#endif
@@ -0,0 +1,95 @@
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+
+#include "common/trace.hpp"
+
+namespace llang {
+namespace trace {
+
+namespace {
+
+struct CategoryName {
+	Category category;
+	const char* name;
+};
+
+const CategoryName categoryNames[] = {
+	{ LEXER, "lexer" },
+	{ PARSE, "parse" },
+	{ SEMA, "sema" },
+	{ CLOSURE, "closure" },
+	{ CODEGEN, "codegen" },
+	{ CACHE, "cache" },
+	{ ALL, "all" }
+};
+
+const size_t categoryCount = sizeof(categoryNames) / sizeof(categoryNames[0]);
+
+} // namespace
+
+#ifdef LLANG_TRACE_ENABLED
+
+unsigned enabledCategories = 0;
+
+void print(Category category, const char* format, ...) {
+	// Formatted first and written with one call, so that lines from
+	// different threads don't interleave
+	char buffer[512];
+	int length = snprintf(buffer, sizeof(buffer), "[%s] ",
+	                      categoryName(category));
+
+	va_list argp;
+	va_start(argp, format);
+	vsnprintf(buffer + length, sizeof(buffer) - static_cast<size_t>(length),
+	          format, argp);
+	va_end(argp);
+
+	// Not stderr, which carries the IR
+	fprintf(stdout, "%s\n", buffer);
+}
+
+#endif
+
+bool enable(const char* names) {
+	bool known = true;
+
+	while (*names) {
+		size_t length = strcspn(names, ",");
+
+		size_t i = 0;
+		while (i < categoryCount &&
+		       (strlen(categoryNames[i].name) != length ||
+		        strncmp(categoryNames[i].name, names, length) != 0))
+			++i;
+
+		if (i < categoryCount) {
+#ifdef LLANG_TRACE_ENABLED
+			enabledCategories |= categoryNames[i].category;
+#endif
+		} else {
+			known = false;
+		}
+
+		names += length;
+		if (*names == ',') ++names;
+	}
+
+#ifndef LLANG_TRACE_ENABLED
+	known = false; // there is nothing to enable
+#endif
+
+	return known;
+}
+
+const char* categoryName(Category category) {
+	for (size_t i = 0; i < categoryCount; ++i) {
+		if (categoryNames[i].category == category)
+			return categoryNames[i].name;
+	}
+
+	return "?";
+}
+
+} // namespace trace
+} // namespace llang
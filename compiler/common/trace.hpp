@@ -0,0 +1,67 @@
+#ifndef LLANG_COMMON_TRACE_HPP_INCLUDED
+#define LLANG_COMMON_TRACE_HPP_INCLUDED
+
+// Debug output of the compiler's internals, in named categories.
+//
+// Trace points are written as
+//
+//   LLANG_TRACE(CLOSURE, "function '%s' uses '%s'", function, variable);
+//
+// and print "[closure] function 'f' uses 'x'" to stdout if the category is
+// enabled. All categories are off by default and are switched on at runtime
+// with trace::enable (the driver's --trace option). With NDEBUG defined
+// trace points compile to nothing, arguments included.
+
+#ifndef NDEBUG
+#define LLANG_TRACE_ENABLED 1
+#endif
+
+namespace llang {
+namespace trace {
+
+enum Category {
+	LEXER = 1 << 0,
+	PARSE = 1 << 1,
+	SEMA = 1 << 2,
+	CLOSURE = 1 << 3,
+	CODEGEN = 1 << 4,
+	CACHE = 1 << 5,
+
+	ALL = (1 << 6) - 1
+};
+
+#ifdef LLANG_TRACE_ENABLED
+
+extern unsigned enabledCategories;
+
+inline bool enabled(Category category) {
+	return enabledCategories & category;
+}
+
+void print(Category category, const char* format, ...)
+	__attribute__((format(printf, 2, 3)));
+
+#define LLANG_TRACE(category, ...) \
+	do { \
+		if (::llang::trace::enabled(::llang::trace::category)) \
+			::llang::trace::print(::llang::trace::category, __VA_ARGS__); \
+	} while (0)
+
+#else
+
+inline bool enabled(Category) { return false; }
+
+#define LLANG_TRACE(category, ...) do {} while (0)
+
+#endif
+
+// Enables a comma-separated list of category names ("parse,closure" or
+// "all"). Returns false if a name is unknown or tracing is compiled out.
+bool enable(const char* names);
+
+const char* categoryName(Category category);
+
+} // namespace trace
+} // namespace llang
+
+#endif
@@ -0,0 +1,178 @@
+#include <atomic>
+#include <chrono>
+#include <mutex>
+
+#include "common/source_manager.hpp"
+#include "common/trace_events.hpp"
+
+namespace llang {
+namespace trace {
+
+FILE* eventFile = 0;
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+Clock::time_point start;
+bool firstEvent = true;
+
+// Events of different threads go to the file one at a time
+std::mutex eventMutex;
+
+// Small numbers for the "tid" field, in the order threads write events
+std::atomic<unsigned> threadCount(0);
+__thread unsigned threadNumber = 0;
+
+unsigned currentThread() {
+	if (!threadNumber)
+		threadNumber = ++threadCount;
+
+	return threadNumber;
+}
+
+void appendEscaped(std::string& out, const char* string) {
+	for (; *string; ++string) {
+		const char c = *string;
+
+		if (c == '"' || c == '\\') {
+			out += '\\';
+			out += c;
+		} else if (static_cast<unsigned char>(c) < 0x20) {
+			char buffer[8];
+			snprintf(buffer, sizeof(buffer), "\\u%04x", c);
+			out += buffer;
+		} else {
+			out += c;
+		}
+	}
+}
+
+void writeEscaped(FILE* file, const char* string) {
+	for (; *string; ++string) {
+		const char c = *string;
+
+		if (c == '"' || c == '\\') {
+			fputc('\\', file);
+			fputc(c, file);
+		} else if (static_cast<unsigned char>(c) < 0x20) {
+			fprintf(file, "\\u%04x", c);
+		} else {
+			fputc(c, file);
+		}
+	}
+}
+
+// Written straight to the file, without formatting the event in a buffer
+// first, to keep tracing out of the allocations --time-passes counts as far
+// as possible
+void writeEvent(char phase, const char* category, const char* name,
+                const std::string& args) {
+	const double microseconds =
+		std::chrono::duration<double, std::micro>(Clock::now() - start)
+		.count();
+	const unsigned thread = currentThread();
+
+	std::lock_guard<std::mutex> lock(eventMutex);
+	if (!eventFile)
+		return;
+
+	fputs(firstEvent ? "[\n" : ",\n", eventFile);
+	firstEvent = false;
+
+	fprintf(eventFile, "{\"ph\":\"%c\",\"cat\":\"", phase);
+	writeEscaped(eventFile, category);
+	fputc('"', eventFile);
+
+	if (name) {
+		fputs(",\"name\":\"", eventFile);
+		writeEscaped(eventFile, name);
+		fputc('"', eventFile);
+	}
+
+	fprintf(eventFile, ",\"pid\":1,\"tid\":%u,\"ts\":%.3f", thread,
+	        microseconds);
+
+	if (!args.empty()) {
+		// Without the last comma
+		fprintf(eventFile, ",\"args\":{%.*s}",
+		        static_cast<int>(args.size() - 1), args.data());
+	}
+
+	fputc('}', eventFile);
+}
+
+} // namespace
+
+bool openEvents(const char* path) {
+	FILE* file = fopen(path, "w");
+	if (!file)
+		return false;
+
+	start = Clock::now();
+	firstEvent = true;
+	eventFile = file;
+
+	return true;
+}
+
+void closeEvents() {
+	std::lock_guard<std::mutex> lock(eventMutex);
+	if (!eventFile)
+		return;
+
+	fputs(firstEvent ? "[]\n" : "\n]\n", eventFile);
+	fclose(eventFile);
+	eventFile = 0;
+}
+
+Span::Span(const char* category, const char* name)
+	: active_(eventsEnabled()), category(category) {
+	if (active_)
+		writeEvent('B', category, name, args);
+}
+
+Span::~Span() {
+	if (active_)
+		writeEvent('E', category, 0, args);
+}
+
+void Span::arg(const char* key, uint64_t value) {
+	if (!active_)
+		return;
+
+	args += '"';
+	appendEscaped(args, key);
+
+	char buffer[32];
+	snprintf(buffer, sizeof(buffer), "\":%llu,",
+	         static_cast<unsigned long long>(value));
+	args += buffer;
+}
+
+void Span::arg(const char* key, const std::string& value) {
+	if (!active_)
+		return;
+
+	args += '"';
+	appendEscaped(args, key);
+	args += "\":\"";
+	appendEscaped(args, value.c_str());
+	args += "\",";
+}
+
+void Span::location(const SourceManager& sources, Location location) {
+	if (!active_ || !location.isValid())
+		return;
+
+	const PresumedLocation presumed = sources.decode(location);
+	if (!presumed.filename)
+		return;
+
+	arg("file", *presumed.filename);
+	arg("line", presumed.line);
+	arg("column", presumed.column);
+}
+
+} // namespace trace
+} // namespace llang
@@ -0,0 +1,71 @@
+#ifndef LLANG_COMMON_TRACE_EVENTS_HPP_INCLUDED
+#define LLANG_COMMON_TRACE_EVENTS_HPP_INCLUDED
+
+#include <cstdio>
+#include <stdint.h>
+#include <string>
+
+#include "common/location.hpp"
+
+namespace llang {
+
+class SourceManager;
+
+namespace trace {
+
+// Timing spans in the Chrome trace event format (the driver's
+// --trace-json option), for chrome://tracing or Perfetto.
+//
+// A span is written as
+//
+//   trace::Span span("phase2", "main");
+//   span.arg("nodes", 42);
+//
+// and becomes a begin event when it's created and an end event, carrying
+// the arguments, when it's destroyed. Viewers nest the spans of a thread
+// and show the arguments of both events together. Unlike trace points,
+// spans stay in release builds; without an open event file they only cost
+// a check.
+
+extern FILE* eventFile;
+
+inline bool eventsEnabled() {
+	return eventFile != 0;
+}
+
+// Starts writing events to the file. Returns false if it can't be opened.
+bool openEvents(const char* path);
+
+// Ends the JSON array and closes the file
+void closeEvents();
+
+class Span {
+public:
+	// The name is copied
+	Span(const char* category, const char* name);
+	~Span();
+
+	// Whether events are written at all, to skip working out arguments
+	bool active() const { return active_; }
+
+	void arg(const char* key, uint64_t value);
+	void arg(const char* key, const std::string& value);
+
+	// Adds "file", "line" and "column"
+	void location(const SourceManager& sources, Location location);
+
+private:
+	Span(const Span&);
+	Span& operator=(const Span&);
+
+	const bool active_;
+	const char* category;
+
+	// JSON members for the end event, each followed by a comma
+	std::string args;
+};
+
+} // namespace trace
+} // namespace llang
+
+#endif
@@ -0,0 +1,245 @@
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <new>
+
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#endif
+
+#include "common/trace_events.hpp"
+#include "driver/pass_manager.hpp"
+
+namespace llang {
+namespace driver {
+
+namespace {
+
+// Only counted while passes are timed, so that it costs a branch otherwise.
+// Set before the passes start their threads.
+bool countAllocations = false;
+std::atomic<uint64_t> allocations(0);
+std::atomic<uint64_t> allocatedBytes(0);
+
+double wallSeconds() {
+	typedef std::chrono::steady_clock Clock;
+	return std::chrono::duration<double>(
+		Clock::now().time_since_epoch()).count();
+}
+
+double cpuSeconds() {
+	struct timespec time;
+	if (clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &time) != 0)
+		return 0;
+
+	return static_cast<double>(time.tv_sec) +
+	       static_cast<double>(time.tv_nsec) / 1e9;
+}
+
+#ifdef __linux__
+
+int openCounter(uint64_t config) {
+	struct perf_event_attr attr;
+	memset(&attr, 0, sizeof(attr));
+	attr.type = PERF_TYPE_HARDWARE;
+	attr.size = sizeof(attr);
+	attr.config = config;
+	attr.inherit = 1; // threads started later
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+
+	return static_cast<int>(syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0));
+}
+
+#else
+
+int openCounter(uint64_t) {
+	return -1;
+}
+
+#endif
+
+} // namespace
+
+PassManager::Measurement::Measurement()
+	: wallSeconds(0), cpuSeconds(0), allocations(0), allocatedBytes(0) {
+	for (size_t i = 0; i < COUNTER_COUNT; ++i)
+		counters[i] = 0;
+}
+
+void PassManager::Measurement::add(const Measurement& other) {
+	wallSeconds += other.wallSeconds;
+	cpuSeconds += other.cpuSeconds;
+	allocations += other.allocations;
+	allocatedBytes += other.allocatedBytes;
+
+	for (size_t i = 0; i < COUNTER_COUNT; ++i)
+		counters[i] += other.counters[i];
+}
+
+PassManager::PassManager(bool timePasses)
+	: timePasses(timePasses), firstToRun(0), haveCounters(false) {
+	for (size_t i = 0; i < COUNTER_COUNT; ++i)
+		counterFds[i] = -1;
+
+	if (!timePasses)
+		return;
+
+	countAllocations = true;
+
+#ifdef __linux__
+	const uint64_t configs[COUNTER_COUNT] = {
+		PERF_COUNT_HW_CPU_CYCLES,
+		PERF_COUNT_HW_INSTRUCTIONS,
+		PERF_COUNT_HW_CACHE_MISSES
+	};
+
+	haveCounters = true;
+	for (size_t i = 0; i < COUNTER_COUNT; ++i) {
+		counterFds[i] = openCounter(configs[i]);
+		haveCounters = haveCounters && counterFds[i] >= 0;
+	}
+#endif
+}
+
+PassManager::~PassManager() {
+	for (size_t i = 0; i < COUNTER_COUNT; ++i) {
+		if (counterFds[i] >= 0)
+			close(counterFds[i]);
+	}
+
+	if (timePasses)
+		countAllocations = false;
+}
+
+void PassManager::add(Pass* pass) {
+	passes.push_back(unique_ptr<Pass>(pass));
+}
+
+void PassManager::run() {
+	for (; firstToRun < passes.size(); ++firstToRun) {
+		Pass& pass = *passes[firstToRun];
+		trace::Span span("pass", pass.name());
+
+		if (!timePasses) {
+			pass.run();
+			continue;
+		}
+
+		const Measurement before = now();
+		pass.run();
+		const Measurement after = now();
+
+		Measurement measurement;
+		measurement.wallSeconds = after.wallSeconds - before.wallSeconds;
+		measurement.cpuSeconds = after.cpuSeconds - before.cpuSeconds;
+		measurement.allocations = after.allocations - before.allocations;
+		measurement.allocatedBytes =
+			after.allocatedBytes - before.allocatedBytes;
+
+		for (size_t i = 0; i < COUNTER_COUNT; ++i)
+			measurement.counters[i] = after.counters[i] - before.counters[i];
+
+		measurements.push_back(measurement);
+	}
+}
+
+PassManager::Measurement PassManager::now() const {
+	Measurement result;
+	result.wallSeconds = wallSeconds();
+	result.cpuSeconds = cpuSeconds();
+	result.allocations = allocations.load(std::memory_order_relaxed);
+	result.allocatedBytes = allocatedBytes.load(std::memory_order_relaxed);
+
+	if (haveCounters) {
+		for (size_t i = 0; i < COUNTER_COUNT; ++i) {
+			uint64_t value = 0;
+			if (read(counterFds[i], &value, sizeof(value)) == sizeof(value))
+				result.counters[i] = value;
+		}
+	}
+
+	return result;
+}
+
+void PassManager::printReport(FILE* out) const {
+	if (!timePasses)
+		return;
+
+	fprintf(out, "%10s %10s %10s %12s %14s %14s %12s  %s\n",
+	        "wall (s)", "cpu (s)", "allocs", "bytes",
+	        "cycles", "instructions", "cache misses", "pass");
+
+	Measurement total;
+	for (size_t i = 0; i < measurements.size(); ++i) {
+		printRow(out, measurements[i], passes[i]->name());
+		total.add(measurements[i]);
+	}
+
+	printRow(out, total, "total");
+
+	if (!haveCounters)
+		fprintf(out, "(no hardware counters: perf_event_open failed)\n");
+}
+
+void PassManager::printRow(FILE* out, const Measurement& measurement,
+                           const char* name) const {
+	fprintf(out, "%10.4f %10.4f %10llu %12llu ",
+	        measurement.wallSeconds, measurement.cpuSeconds,
+	        static_cast<unsigned long long>(measurement.allocations),
+	        static_cast<unsigned long long>(measurement.allocatedBytes));
+
+	if (haveCounters) {
+		fprintf(out, "%14llu %14llu %12llu ",
+		        static_cast<unsigned long long>(measurement.counters[CYCLES]),
+		        static_cast<unsigned long long>(
+		            measurement.counters[INSTRUCTIONS]),
+		        static_cast<unsigned long long>(
+		            measurement.counters[CACHE_MISSES]));
+	} else {
+		fprintf(out, "%14s %14s %12s ", "-", "-", "-");
+	}
+
+	fprintf(out, " %s\n", name);
+}
+
+} // namespace driver
+} // namespace llang
+
+// Counts allocations for the report. operator new[] and the nothrow
+// versions go through here as well.
+
+void* operator new(std::size_t size) {
+	using namespace llang::driver;
+
+	if (countAllocations) {
+		allocations.fetch_add(1, std::memory_order_relaxed);
+		allocatedBytes.fetch_add(size, std::memory_order_relaxed);
+	}
+
+	if (size == 0)
+		size = 1;
+
+	for (;;) {
+		if (void* memory = std::malloc(size))
+			return memory;
+
+		std::new_handler handler = std::set_new_handler(0);
+		std::set_new_handler(handler);
+
+		if (!handler)
+			throw std::bad_alloc();
+
+		handler();
+	}
+}
+
+void operator delete(void* memory) throw() {
+	std::free(memory);
+}
@@ -0,0 +1,97 @@
+#ifndef LLANG_DRIVER_PASS_MANAGER_HPP_INCLUDED
+#define LLANG_DRIVER_PASS_MANAGER_HPP_INCLUDED
+
+#include <cstdio>
+#include <stdint.h>
+#include <vector>
+
+#include "util/smart_ptr.hpp"
+
+namespace llang {
+namespace driver {
+
+// One step of a compiler run, like lexing or codegen. Passes get what they
+// work on when they're created.
+class Pass {
+public:
+	virtual ~Pass() {}
+
+	// Shown in the --time-passes report
+	virtual const char* name() const = 0;
+
+	virtual void run() = 0;
+};
+
+// Runs passes in the order they were added, each in a span of
+// --trace-json (see common/trace_events.hpp), and, with timing enabled,
+// measures every one of them:
+//
+//   - wall and CPU time, the latter of all threads of the process
+//   - the number and size of allocations made with operator new; memory
+//     from an arena only counts when the arena gets a new block
+//   - CPU cycles, instructions and cache misses of the process in user
+//     space, if perf_event_open is available and allowed (see
+//     /proc/sys/kernel/perf_event_paranoid). The counts of other threads
+//     are only included once they have exited.
+class PassManager {
+public:
+	explicit PassManager(bool timePasses);
+	~PassManager();
+
+	// Takes ownership
+	void add(Pass* pass);
+
+	// Runs the passes added since the last call, so that the passes to add
+	// can depend on the outcome of earlier ones
+	void run();
+
+	// Measurements of all passes run so far, and their total. Does nothing
+	// if timing is disabled.
+	void printReport(FILE* out) const;
+
+private:
+	PassManager(const PassManager&);
+	PassManager& operator=(const PassManager&);
+
+	enum Counter {
+		CYCLES,
+		INSTRUCTIONS,
+		CACHE_MISSES,
+
+		COUNTER_COUNT
+	};
+
+	struct Measurement {
+		Measurement();
+
+		double wallSeconds;
+		double cpuSeconds;
+		uint64_t allocations;
+		uint64_t allocatedBytes;
+		uint64_t counters[COUNTER_COUNT];
+
+		void add(const Measurement& other);
+	};
+
+	// Current values of everything measured, since some point in the past
+	Measurement now() const;
+
+	void printRow(FILE* out, const Measurement& measurement,
+	              const char* name) const;
+
+	const bool timePasses;
+
+	std::vector<unique_ptr<Pass>> passes;
+	size_t firstToRun;
+
+	std::vector<Measurement> measurements; // of the passes run
+
+	// perf_event_open file descriptors, -1 if unavailable
+	int counterFds[COUNTER_COUNT];
+	bool haveCounters;
+};
+
+} // namespace driver
+} // namespace llang
+
+#endif
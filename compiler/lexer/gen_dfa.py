@@ -0,0 +1,240 @@
+#!/usr/bin/python
+#
+# Generates the lexer's byte class and DFA transition tables and its keyword
+# lookup from a token specification.
+#
+# Usage: gen_dfa.py tokens.spec dfa.inc
+
+from __future__ import print_function
+
+import sys
+
+RUNS = ['identifier', 'number', 'string', 'end']
+
+ACTIONS = ['ERROR', 'TOKEN', 'IDENTIFIER', 'NUMBER', 'STRING', 'END_OF_FILE']
+
+def parse_characters(words):
+    chars = set()
+    for word in words:
+        if word == '\\0':
+            chars.add(0)
+        elif len(word) == 3 and word[1] == '-':
+            chars.update(range(ord(word[0]), ord(word[2]) + 1))
+        elif len(word) == 1:
+            chars.add(ord(word))
+        else:
+            raise ValueError('bad character set: ' + word)
+    return chars
+
+def parse_spec(path):
+    runs = {}
+    operators = []
+    keywords = []
+
+    for number, line in enumerate(open(path), 1):
+        line = line.strip()
+        if not line or line.startswith('#'):
+            continue
+
+        try:
+            if line.startswith('"'):
+                end = line.index('"', 1)
+                text, token = line[1:end], line[end + 1:].strip()
+                if not text or not token:
+                    raise ValueError('expected "<text>" <token>')
+                operators.append((text, token))
+            elif line.split()[0] == 'keyword':
+                words = line.split()
+                if len(words) != 3:
+                    raise ValueError('expected keyword <text> <token>')
+                keywords.append((words[1], words[2]))
+            else:
+                words = line.split()
+                if words[0] not in RUNS:
+                    raise ValueError('unknown run ' + words[0])
+                runs[words[0]] = parse_characters(words[1:])
+        except ValueError as e:
+            sys.exit('%s:%d: %s' % (path, number, e))
+
+    for run in RUNS:
+        if run not in runs:
+            sys.exit('%s: missing run %s' % (path, run))
+
+    return runs, operators, keywords
+
+def check_keywords(runs, keywords):
+    # The lexer only looks up words it scanned as identifiers
+    texts = set()
+    for text, token in keywords:
+        if (ord(text[0]) not in runs['identifier'] or
+                not all(c.isalnum() or c == '_' for c in text)):
+            sys.exit('keyword "%s" is not an identifier' % text)
+        if text in texts:
+            sys.exit('keyword "%s" is defined twice' % text)
+        texts.add(text)
+
+def build_dfa(runs, operators):
+    # State 0 is the start state, then one terminal state per run, then the
+    # operator trie
+    transitions = [{}]
+    actions = ['ERROR']
+    tokens = [None]
+
+    for run in RUNS:
+        state = len(transitions)
+        transitions.append({})
+        actions.append(run.upper() if run != 'end' else 'END_OF_FILE')
+        tokens.append(None)
+
+        for char in runs[run]:
+            if char in transitions[0]:
+                sys.exit('character %r starts several runs' % chr(char))
+            transitions[0][char] = state
+
+    for text, token in sorted(operators):
+        state = 0
+        for char in map(ord, text):
+            if char not in transitions[state]:
+                if state == 0 and char in transitions[0]:
+                    sys.exit('operator "%s" conflicts with a run' % text)
+                transitions.append({})
+                actions.append('TOKEN')
+                tokens.append(None)
+                transitions[state][char] = len(transitions) - 1
+            state = transitions[state][char]
+
+        if tokens[state] is not None:
+            sys.exit('operator "%s" is defined twice' % text)
+        tokens[state] = token
+
+    return transitions, actions, tokens
+
+def build_classes(transitions):
+    # Bytes that behave the same in every state share a class. Class 0 is
+    # made up of the bytes that don't start or continue any token.
+    signatures = {}
+    byte_classes = []
+
+    dead = tuple(None for state in transitions)
+    signatures[dead] = 0
+
+    for byte in range(256):
+        signature = tuple(state.get(byte) for state in transitions)
+        if signature not in signatures:
+            signatures[signature] = len(signatures)
+        byte_classes.append(signatures[signature])
+
+    classes = [None] * len(signatures)
+    for signature, index in signatures.items():
+        classes[index] = signature
+
+    return byte_classes, classes
+
+def write_tables(path, spec, transitions, actions, tokens, byte_classes,
+                 classes, keywords):
+    dead = 255
+    if len(transitions) >= dead:
+        sys.exit('too many states')
+
+    out = open(path, 'w')
+    w = lambda s='': print(s, file=out)
+
+    w('// Generated by gen_dfa.py from %s, do not edit.' % spec)
+    w()
+    w('namespace dfa {')
+    w()
+    w('enum {')
+    w('\tSTART = 0,')
+    w('\tDEAD = %d,' % dead)
+    w('\tSTATE_COUNT = %d,' % len(transitions))
+    w('\tCLASS_COUNT = %d' % len(classes))
+    w('};')
+    w()
+    w('enum Action {')
+    w(',\n'.join('\t' + action for action in ACTIONS))
+    w('};')
+    w()
+    w('const unsigned char byteClasses[256] = {')
+    for row in range(16):
+        w('\t' + ', '.join('%2d' % c for c in byte_classes[row * 16:row * 16 + 16]) +
+          (',' if row < 15 else ''))
+    w('};')
+    w()
+    # The first step out of the start state, by byte, so that the lexer can
+    # dispatch on a token's first byte with a single lookup. Bytes that
+    # can't start a token stay in the start state, whose action is ERROR.
+    start_states = [transitions[0].get(byte, 0) for byte in range(256)]
+    start_actions = [ACTIONS.index(actions[state]) for state in start_states]
+
+    for name, table, comment in (
+            ('startStates', start_states,
+             'State after the first byte of a token, START if there is none'),
+            ('startActions', start_actions, 'Action of that state, by byte')):
+        w('// ' + comment)
+        w('const unsigned char %s[256] = {' % name)
+        for row in range(16):
+            w('\t' + ', '.join('%2d' % x for x in table[row * 16:row * 16 + 16]) +
+              (',' if row < 15 else ''))
+        w('};')
+        w()
+
+    w('const unsigned char transitions[STATE_COUNT][CLASS_COUNT] = {')
+    for index, state in enumerate(transitions):
+        row = []
+        for signature in classes:
+            target = signature[index]
+            row.append('%3d' % (dead if target is None else target))
+        w('\t{ ' + ', '.join(row) + ' }' +
+          (',' if index < len(transitions) - 1 else ''))
+    w('};')
+    w()
+    w('// Token type of TOKEN states, ENUM_MAX if they are only the prefix of')
+    w('// longer operators')
+    w('const Token::Type tokens[STATE_COUNT] = {')
+    w(',\n'.join('\tToken::' + (token or 'ENUM_MAX') for token in tokens))
+    w('};')
+    w()
+    write_keywords(w, keywords)
+    w()
+    w('} // namespace dfa')
+
+def write_keywords(w, keywords):
+    # A switch on the length and first character, then a single memcmp per
+    # candidate, like a hand-written one would be
+    w('// Checks if the slice [start, start + length) is a keyword')
+    w('inline bool keyword(const char* start, size_t length, Token::Type& outType) {')
+    w('\tswitch (length) {')
+    for length in sorted(set(len(text) for text, token in keywords)):
+        w('\tcase %d:' % length)
+        w('\t\tswitch (*start) {')
+        for first in sorted(set(text[0] for text, token in keywords
+                                if len(text) == length)):
+            w("\t\tcase '%s':" % first)
+            for text, token in sorted(keywords):
+                if len(text) == length and text[0] == first:
+                    w('\t\t\tif (memcmp(start, "%s", %d) == 0) {' % (text, length))
+                    w('\t\t\t\toutType = Token::%s;' % token)
+                    w('\t\t\t\treturn true;')
+                    w('\t\t\t}')
+            w('\t\t\tbreak;')
+        w('\t\t}')
+        w('\t\tbreak;')
+    w('\t}')
+    w()
+    w('\treturn false;')
+    w('}')
+
+def main():
+    if len(sys.argv) != 3:
+        sys.exit('usage: gen_dfa.py <spec> <output>')
+
+    spec, output = sys.argv[1:]
+
+    runs, operators, keywords = parse_spec(spec)
+    check_keywords(runs, keywords)
+    transitions, actions, tokens = build_dfa(runs, operators)
+    byte_classes, classes = build_classes(transitions)
+    write_tables(output, spec, transitions, actions, tokens, byte_classes,
+                 classes, keywords)
+
+main()
@@ -1,49 +1,26 @@
 #include <stdexcept>
 #include <cassert>
-#include <cctype>
-#include <map>
-#include <sstream>
+#include <cstring>
+#include <cstdarg>
 
+#include "util/scan.hpp"
 #include "lexer/lexer.hpp"
 
 namespace llang {
 namespace lexer {
 
-typedef std::map<identifier_t, Token::Type> keyword_map_t;
-
-keyword_map_t makeKeywordMap()
-{
-	keyword_map_t map;
-
-	map["fn"] = Token::KEYWORD_FN;
-	map["var"] = Token::KEYWORD_VAR;
-	map["if"] = Token::KEYWORD_IF;
-	map["else"] = Token::KEYWORD_ELSE;
-	map["i32"] = Token::KEYWORD_I32;
-	map["int"] = Token::KEYWORD_INT;
-	map["void"] = Token::KEYWORD_VOID;
-	map["string"] = Token::KEYWORD_STRING;
-	map["char"] = Token::KEYWORD_CHAR;
-	map["bool"] = Token::KEYWORD_BOOL;
-	map["true"] = Token::KEYWORD_TRUE;
-	map["false"] = Token::KEYWORD_FALSE;
-	map["extern"] = Token::KEYWORD_EXTERN;
-	map["arr"] = Token::KEYWORD_ARRAY;
-
-	return map;
-}
-
-const keyword_map_t keywords = makeKeywordMap();
+namespace {
 
-bool isKeyword(const identifier_t& identifier,
-               Token::Type& outType) {
-	keyword_map_t::const_iterator elemIterator = keywords.find(identifier);
+#include "lexer/dfa.inc"
 
-	if (elemIterator == keywords.end())
-		return false;
+} // namespace
 
-	outType = elemIterator->second;
-	return true;
+// Keywords come from tokens.spec, gen_dfa.py turns them into a switch on their
+// length and first character followed by a single memcmp. This works on the
+// raw slice, so no string is built unless the word turns out to be an
+// identifier.
+bool isKeyword(const char* start, size_t length, Token::Type& outType) {
+	return dfa::keyword(start, length, outType);
 }
 
 Token Lexer::lexToken() {
@@ -52,157 +29,183 @@ Token Lexer::lexToken() {
 
 	while (eatWhitespace() || eatComments());
 
-	Location location(filename, line, static_cast<size_t>(c - lineStart) + 1);
-	
-	switch (*c) {
-		// TODO: this repetiton kind of sucks
-		case '(':
-			++c;
-			return Token(location, Token::LPAREN);	
-		case ')':
-			++c;
-			return Token(location, Token::RPAREN);	
-		case '=':
-			++c;
-			return Token(location, Token::EQUALS);	
-		case ';':
-			++c;
-			return Token(location, Token::SEMICOLON);
-		case ',':
-			++c;
-			return Token(location, Token::COMMA);
-		case '{':
-			++c;
-			return Token(location, Token::LBRACE);
-		case '}':
-			++c;
-			return Token(location, Token::RBRACE);
-		case '+':
-			++c;
-			return Token(location, Token::PLUS);
-		case '*':
-			++c;
-			return Token(location, Token::STAR);
-		case '-':
-			++c;
-			return Token(location, Token::MINUS);
-		case '/':
-			++c;
-			return Token(location, Token::SLASH);
-		case '[':
-			++c;
-			return Token(location, Token::LBRACKET);
-		case ']':
-			++c;
-			return Token(location, Token::RBRACKET);
-		case '"':
-			return lexStringLiteral(location);
-		case '\0':
-			endOfFile = true;
-			return Token(location, Token::END_OF_FILE);
-		default:
-			if (isalpha(*c) || *c == '_')
-				return lexIdentifier(location);
-			else if (isdigit(*c))
-				return lexNumber(location);
-
-			// TODO: error
-			assert(false);
+	const Location location(base.offset +
+		static_cast<uint32_t>(c - source.begin()));
+
+	// The first byte decides the kind of token. Its action comes straight
+	// from a table, so runs go to their scanners without stepping the DFA
+	// generated from tokens.spec; only operators walk it any further.
+	const unsigned char first = static_cast<unsigned char>(*c);
+
+	switch (dfa::startActions[first]) {
+	case dfa::IDENTIFIER:
+		return lexIdentifier(location);
+
+	case dfa::TOKEN:
+		return lexOperator(location, dfa::startStates[first]);
+
+	case dfa::NUMBER:
+		return lexNumber(location);
+
+	case dfa::STRING:
+		return lexStringLiteral(location);
+
+	case dfa::END_OF_FILE:
+		if (window)
+			throw EndOfWindow();
+
+		endOfFile = true;
+		return Token(location, Token::END_OF_FILE, 0);
+
+	case dfa::ERROR:
+		error(location, "unexpected character '%c'", *c);
 	}
 
 	assert(false);
 }
 
-Token Lexer::lexIdentifier(const Location& location) {
-	assert(isalpha(*c) || *c == '_');
+// Longest match, starting in the state after the first byte. States that
+// are only the prefix of longer operators have no token; if the match ends
+// in one, the lexer backs up to the last operator it passed.
+Token Lexer::lexOperator(const Location& location, unsigned state) {
+	const char* start = c++;
+	const char* end = 0; // of the longest operator so far
+	Token::Type type = Token::ENUM_MAX;
+
+	for (;;) {
+		if (dfa::tokens[state] != Token::ENUM_MAX) {
+			type = dfa::tokens[state];
+			end = c;
+		}
 
-	const char* start = c;
-	size_t length = 0;
+		unsigned next = dfa::transitions[state]
+			[dfa::byteClasses[static_cast<unsigned char>(*c)]];
+		if (next == dfa::DEAD) break;
 
-	while (isalpha(*c) || *c == '_' || isdigit(*c)) {
-		++length;
+		state = next;
 		++c;
 	}
 
-	std::string identifier(start, length);
+	// Stays where the match ended, which might be the end of a window
+	if (!end)
+		error(location, "unexpected character '%c'", *start);
+
+	c = end;
+	return Token(location, type, static_cast<uint32_t>(c - start));
+}
+
+Token Lexer::lexIdentifier(const Location& location) {
+	assert(scan::is(*c, scan::IDENTIFIER_START));
+
+	const char* start = c;
+	c = scan::skipIdentifier(c + 1);
+	const size_t length = static_cast<size_t>(c - start);
+
 	Token::Type tokenType;
 
-	if (isKeyword(identifier, tokenType))
-		return Token(location, tokenType);
+	if (isKeyword(start, length, tokenType))
+		return Token(location, tokenType, static_cast<uint32_t>(length));
 	else
-		return Token(location, identifier);
+		return Token(location, Token::IDENTIFIER, static_cast<uint32_t>(length),
+		             identifiers.intern(start, length).id());
 }
 
 Token Lexer::lexNumber(const Location& location) {
-	assert(isdigit(*c));
+	assert(scan::is(*c, scan::DIGIT));
 
+	const char* start = c;
 	int_t number = 0;
 
-	while (isdigit(*c)) {
+	for (const char* end = scan::skipDigits(c); c != end; ++c) {
 		int_t digit = static_cast<int>(*c - '0');
 		number = number * 10 + digit;
-			
-		++c;
 	}
 
-	return Token(location, number);
+	return Token(location, Token::NUMBER, static_cast<uint32_t>(c - start),
+	             static_cast<uint32_t>(number));
 }
 
 Token Lexer::lexStringLiteral(const Location& location) {
 	assert(*c == '"');
-	++c;
+	const char* start = c++;
+	bool escapes = false;
+
+	// Only validate escape sequences here, stringValue decodes them
+	for (;;) {
+		// Nothing interesting in most of the literal
+		while (*c != '"' && *c != '\\' && *c != '\0') ++c;
 
-	std::stringstream ss;
-
-	// TODO: escape sequences
-	while (*c != '"') {
-		if (*c == '\0') {
-			diag.error(location, "unterminated string literal");
-		} else if (*c != '\\') {
-			ss << *c++;
-		} else  {
-			++c;
-			
-			switch (*c) {
-			case '\\': ss << '\\'; break;
-			case 'n': ss << '\n'; break;
-			case '"': ss << '"'; break;
-			case '0': ss << '\0'; break;
-			default: diag.error(location, "unrecognized escape sequence");
-			}
-
-			++c;
+		if (*c == '"') break;
+
+		if (*c == '\0')
+			error(location, "unterminated string literal");
+
+		++c;
+
+		switch (*c) {
+		case '\\': case 'n': case '"': case '0': break;
+		default: error(location, "unrecognized escape sequence");
 		}
-	} 
 
-	++c;
+		++c;
+		escapes = true;
+	}
 
-	std::string string(ss.str());
+	++c;
 
-	return Token(location, string, Token::STRING);
+	return Token(location, Token::STRING, static_cast<uint32_t>(c - start),
+	             escapes);
 }
 
-bool Lexer::eatWhitespace() {
-	const char* start = c;
+StringLiteral Lexer::stringValue(const Token& token) {
+	assert(token.type == Token::STRING);
+
+	// Skip the quotes
+	const char* c = text(token) + 1;
+	const char* end = text(token) + token.length - 1;
+
+	StringLiteral literal = { c, static_cast<size_t>(end - c) };
+	if (!token.hasEscapes())
+		return literal;
 
-	while (*c == ' ' || *c == '\t' || *c == '\n') {
-		if (*c == '\n') { // TODO: CRLF
-			++line;
-			lineStart = c + 1;
+	// Decoding only makes the literal shorter
+	char* data = literals.allocate(literal.length);
+	char* out = data;
+
+	while (c != end) {
+		if (*c != '\\') {
+			*out++ = *c++;
+			continue;
 		}
+
 		++c;
+
+		switch (*c++) {
+		case '\\': *out++ = '\\'; break;
+		case 'n': *out++ = '\n'; break;
+		case '"': *out++ = '"'; break;
+		case '0': *out++ = '\0'; break;
+		default: assert(false);
+		}
 	}
 
-	return start != c;
+	literal.data = data;
+	literal.length = static_cast<size_t>(out - data);
+	return literal;
 }
 
-bool Lexer::eatComments() {
-	if (*c == '/' && *(c + 1) == '/') {
-		while(*++c != '\n');	
-		return true;
-	}
-	
-	return false;
+void Lexer::error(const Location& location, const char* format, ...) {
+	if (speculative)
+		throw SpeculationFailed();
+
+	// Whatever ran into the end might go on in the rest of the file
+	if (window && c >= source.end())
+		throw EndOfWindow();
+
+	va_list argp;
+	va_start(argp, format);
+	diag.verror(location, format, argp);
+	va_end(argp);
 }
 
 } // namespace llang
@@ -4,41 +4,121 @@
 #include <string>
 
 #include "common/context.hpp"
+#include "common/source_manager.hpp"
 #include "lexer/token.hpp"
+#include "util/scan.hpp"
 
 namespace llang {
 namespace lexer {
 
+// Checks if the slice [start, start + length) is a keyword
+bool isKeyword(const char* start, size_t length, Token::Type& outType);
+
+// Thrown instead of reporting an error by speculative lexers
+struct SpeculationFailed {};
+
+// Thrown when a lexer reaches the end of a buffer that is only a window of
+// its file (see SourceManager::setWindow), instead of ending the file there
+struct EndOfWindow {};
+
 class Lexer {
 public:
-	Lexer(Context& context,
-	      const std::string& filename,
-	      const std::string& source)
-		: diag(context.diag), filename(filename), source(source),
-		  c(source.c_str()), lineStart(c), endOfFile(false), line(1) {
+	// Scans the file's source buffer in place
+	Lexer(Context& context, SourceManager::FileId file)
+		: diag(context.diag), identifiers(context.identifiers),
+		  literals(context.literals),
+		  source(context.sources.buffer(file)),
+		  base(context.sources.location(file,
+		       context.sources.bufferOffset(file))),
+		  c(source.begin()), endOfFile(false), speculative(false),
+		  window(isWindow(context.sources, file)) {
+	}
+
+	// Starts at offset, which must not be inside a token, and interns
+	// identifiers into the given interner. Speculative lexers throw
+	// SpeculationFailed instead of reporting errors.
+	Lexer(Context& context, SourceManager::FileId file, size_t offset,
+	      Interner& identifiers, bool speculative)
+		: diag(context.diag), identifiers(identifiers),
+		  literals(context.literals),
+		  source(context.sources.buffer(file)),
+		  base(context.sources.location(file,
+		       context.sources.bufferOffset(file))),
+		  c(source.begin() + (offset - context.sources.bufferOffset(file))),
+		  endOfFile(false), speculative(speculative),
+		  window(isWindow(context.sources, file)) {
 	}
 
 	Token lexToken();
 
+	// Skips whitespace and comments, returning the offset at which the next
+	// token starts
+	size_t nextTokenOffset() {
+		while (eatWhitespace() || eatComments());
+		return static_cast<size_t>(c - source.begin());
+	}
+
+	size_t sourceSize() const { return source.size(); }
+
+	// Start of the token's text in the source buffer
+	const char* text(const Token& token) const {
+		return source.begin() + (token.location.offset - base.offset);
+	}
+
+	// Contents of a STRING token. Only literals with escape sequences are
+	// decoded (into the literal pool), others point into the source.
+	StringLiteral stringValue(const Token& token);
+
 private:
-	Token lexIdentifier(const Location& location);
-	Token lexNumber(const Location& location);
+	// Only called from lexToken, which they are inlined into
+	inline Token lexOperator(const Location& location, unsigned state);
+	inline Token lexIdentifier(const Location& location);
+	inline Token lexNumber(const Location& location);
 	Token lexStringLiteral(const Location& location);
 
-	bool eatWhitespace();
-	bool eatComments();
+	bool eatWhitespace() {
+		const char* start = c;
+
+		// Most runs are a single space, skip those without the loop
+		if (scan::is(*c, scan::WHITESPACE)) {
+			++c;
+			if (scan::is(*c, scan::WHITESPACE))
+				c = scan::skipWhitespace(c);
+		}
+
+		return start != c;
+	}
+
+	bool eatComments() {
+		if (*c == '/' && *(c + 1) == '/') {
+			// Stops at the terminating '\0' if the last line is a comment
+			c = scan::findLineEnd(c + 2);
+			return true;
+		}
+
+		return false;
+	}
+
+	void error(const Location& location, const char* format, ...);
+
+	static bool isWindow(const SourceManager& sources,
+	                     SourceManager::FileId file) {
+		return sources.bufferOffset(file) + sources.buffer(file).size() <
+		       sources.size(file);
+	}
 
 	Diagnostics& diag;
+	Interner& identifiers;
+	LiteralPool& literals;
 
-	const std::string filename;
-	const std::string source;
+	const SourceBuffer& source;
+	const Location base; // location of the first byte in source
 
 	const char* c; // pointer into source
-	const char* lineStart;
 
 	bool endOfFile; // end of file reached?
-
-	size_t line; // current line in source
+	const bool speculative;
+	const bool window; // the buffer ends before the file does
 };
 
 } // namespace lexer
@@ -0,0 +1,248 @@
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <functional>
+#include <thread>
+
+#include "common/interner.hpp"
+#include "common/trace.hpp"
+#include "lexer/lexer.hpp"
+#include "lexer/parallel_lexer.hpp"
+
+namespace llang {
+namespace lexer {
+
+namespace {
+
+bool startsBefore(const Token& token, const Location& location) {
+	return token.location.offset < location.offset;
+}
+
+} // namespace
+
+struct ParallelLexer::Chunk {
+	size_t begin, end; // offsets, the last chunk ends past the '\0'
+
+	// Speculative results. Identifiers are interned into the chunk's own
+	// interner, so the workers don't have to share one.
+	std::vector<Token> tokens;
+	Interner identifiers;
+
+	// Offset of the first token not in tokens. If failed, that token is
+	// where the speculative lexer hit an error.
+	size_t next;
+	bool failed;
+
+	std::vector<uint32_t> remap; // chunk identifier ids to global ones
+
+	Chunk(size_t begin, size_t end)
+		: begin(begin), end(end), next(0), failed(false) {
+	}
+};
+
+ParallelLexer::ParallelLexer(Context& context, SourceManager::FileId file,
+                             unsigned threads, size_t minChunkSize)
+	: context(context), file(file),
+	  size(context.sources.buffer(file).size()),
+	  base(context.sources.location(file, 0)),
+	  threads(threads), minChunkSize(minChunkSize) {
+	if (this->threads == 0)
+		this->threads = std::max(1u, std::thread::hardware_concurrency());
+}
+
+void ParallelLexer::lexAll(std::vector<Token>& tokens) {
+	split();
+
+	LLANG_TRACE(LEXER, "%zu bytes in %zu chunks", size, chunks.size());
+
+	if (chunks.size() == 1) {
+		Lexer lexer(context, file);
+
+		tokens.reserve(size / 4 + 1);
+		do tokens.push_back(lexer.lexToken());
+		while (tokens.back().type != Token::END_OF_FILE);
+
+		return;
+	}
+
+	std::vector<std::thread> workers;
+	for (size_t i = 0; i < chunks.size(); ++i)
+		workers.push_back(std::thread(&ParallelLexer::lexChunk, this,
+		                              std::ref(*chunks[i])));
+	for (size_t i = 0; i < workers.size(); ++i)
+		workers[i].join();
+
+	stitch();
+
+	// Copy the pieces into place, giving each thread an equal share of the
+	// result
+	size_t total = pieces.back().output + pieces.back().count;
+	tokens.resize(total);
+
+	workers.clear();
+	for (size_t i = 0; i < threads; ++i) {
+		workers.push_back(std::thread(&ParallelLexer::copy, this,
+		                              std::ref(tokens), total * i / threads,
+		                              total * (i + 1) / threads));
+	}
+	for (size_t i = 0; i < workers.size(); ++i)
+		workers[i].join();
+
+	assert(tokens.back().type == Token::END_OF_FILE);
+}
+
+void ParallelLexer::split() {
+	const char* source = context.sources.buffer(file).begin();
+
+	size_t count = std::max<size_t>(1,
+		std::min<size_t>(threads, size / minChunkSize));
+
+	size_t begin = 0;
+	for (size_t i = 1; i < count; ++i) {
+		size_t offset = std::max(begin, size * i / count);
+
+		const void* newline = memchr(source + offset, '\n', size - offset);
+		if (!newline) break;
+
+		size_t end = static_cast<const char*>(newline) - source + 1;
+		if (end == size) break;
+
+		chunks.push_back(ChunkPtr(new Chunk(begin, end)));
+		begin = end;
+	}
+
+	// Make sure the last chunk gets END_OF_FILE
+	chunks.push_back(ChunkPtr(new Chunk(begin, size + 1)));
+}
+
+void ParallelLexer::lexChunk(Chunk& chunk) {
+	Lexer lexer(context, file, chunk.begin, chunk.identifiers, true);
+	chunk.tokens.reserve((chunk.end - chunk.begin) / 4 + 1);
+
+	try {
+		for (;;) {
+			chunk.next = lexer.nextTokenOffset();
+			if (chunk.next >= chunk.end) break;
+
+			chunk.tokens.push_back(lexer.lexToken());
+
+			if (chunk.tokens.back().type == Token::END_OF_FILE) {
+				chunk.next = size + 1;
+				break;
+			}
+		}
+	} catch (const SpeculationFailed&) {
+		chunk.failed = true;
+	}
+}
+
+void ParallelLexer::stitch() {
+	runs.push_back(std::vector<Token>());
+
+	size_t next = 0; // offset of the next token in the result
+
+	for (size_t i = 0; i < chunks.size(); ++i) {
+		Chunk& chunk = *chunks[i];
+
+		// A multi-line string might have covered the whole chunk
+		while (next < chunk.end) {
+			// Look for a speculative token at the same offset. From there
+			// on, both lexers see the same input and produce the same
+			// tokens.
+			const Location location(base.offset + static_cast<uint32_t>(next));
+
+			std::vector<Token>::const_iterator token = std::lower_bound(
+				chunk.tokens.begin(), chunk.tokens.end(), location,
+				startsBefore);
+
+			if (token != chunk.tokens.end() &&
+			    token->location.offset == location.offset) {
+				splice(chunk, token - chunk.tokens.begin());
+				next = chunk.next;
+
+				if (!chunk.failed) break;
+
+				// The error is real, relexing the token reports it
+			}
+
+			// Relex a single token and try again
+			LLANG_TRACE(LEXER, "chunk %zu: relexing at offset %zu", i, next);
+			Lexer lexer(context, file, next, context.identifiers, false);
+			runs.back().push_back(lexer.lexToken());
+
+			if (runs.back().back().type == Token::END_OF_FILE)
+				break;
+
+			next = lexer.nextTokenOffset();
+		}
+	}
+
+	endRun();
+}
+
+void ParallelLexer::splice(Chunk& chunk, size_t index) {
+	assert(chunk.remap.empty());
+
+	endRun();
+
+	// Intern the chunk's identifiers in the order in which they first
+	// appear, like the serial lexer would. If the chunk is used from its
+	// start, that's the order of the chunk's ids.
+	chunk.remap.resize(chunk.identifiers.size(), 0);
+
+	if (index == 0) {
+		for (uint32_t id = 1; id < chunk.remap.size(); ++id) {
+			chunk.remap[id] = context.identifiers.intern(
+				chunk.identifiers.str(identifier_t(id))).id();
+		}
+	} else {
+		for (size_t i = index; i < chunk.tokens.size(); ++i) {
+			const Token& token = chunk.tokens[i];
+
+			if (token.type == Token::IDENTIFIER && !chunk.remap[token.value]) {
+				chunk.remap[token.value] = context.identifiers.intern(
+					chunk.identifiers.str(token.identifier())).id();
+			}
+		}
+	}
+
+	Piece piece = { &chunk.tokens[index], chunk.tokens.size() - index,
+	                &chunk.remap[0], 0 };
+	if (!pieces.empty())
+		piece.output = pieces.back().output + pieces.back().count;
+	pieces.push_back(piece);
+}
+
+void ParallelLexer::endRun() {
+	std::vector<Token>& run = runs.back();
+	if (run.empty()) return;
+
+	Piece piece = { &run[0], run.size(), 0, 0 };
+	if (!pieces.empty())
+		piece.output = pieces.back().output + pieces.back().count;
+	pieces.push_back(piece);
+
+	runs.push_back(std::vector<Token>());
+}
+
+void ParallelLexer::copy(std::vector<Token>& tokens,
+                         size_t begin, size_t end) const {
+	for (size_t i = 0; i < pieces.size(); ++i) {
+		const Piece& piece = pieces[i];
+
+		size_t from = std::max(begin, piece.output);
+		size_t to = std::min(end, piece.output + piece.count);
+
+		for (size_t j = from; j < to; ++j) {
+			Token token = piece.tokens[j - piece.output];
+
+			if (piece.remap && token.type == Token::IDENTIFIER)
+				token.value = piece.remap[token.value];
+
+			tokens[j] = token;
+		}
+	}
+}
+
+} // namespace lexer
+} // namespace llang
@@ -0,0 +1,75 @@
+#ifndef LLANG_LEXER_PARALLEL_LEXER_HPP_INCLUDED
+#define LLANG_LEXER_PARALLEL_LEXER_HPP_INCLUDED
+
+#include <list>
+#include <vector>
+
+#include <boost/shared_ptr.hpp>
+
+#include "common/context.hpp"
+#include "common/source_manager.hpp"
+#include "lexer/token.hpp"
+
+namespace llang {
+namespace lexer {
+
+// Lexes a whole file on several threads.
+//
+// The buffer is split into chunks at newlines, and every chunk is lexed
+// speculatively, as if it started between two tokens. Comments end at
+// newlines, so the only way to be wrong is a chunk starting inside a
+// multi-line string literal. Chunks are then validated in order: if the
+// previous chunk ended at a token offset the speculative lexer also saw,
+// the rest of its tokens are taken as they are. Otherwise the lexer is
+// resynchronized by relexing serially until the offsets agree again.
+//
+// The result is identical to calling Lexer::lexToken until END_OF_FILE,
+// including the order in which identifiers are interned, and errors are
+// reported in source order.
+class ParallelLexer {
+public:
+	// threads == 0 uses one thread per core. Chunks are at least
+	// minChunkSize bytes, smaller files are lexed serially.
+	ParallelLexer(Context& context, SourceManager::FileId file,
+	              unsigned threads = 0, size_t minChunkSize = 1 << 20);
+
+	void lexAll(std::vector<Token>& tokens);
+
+private:
+	struct Chunk;
+	typedef boost::shared_ptr<Chunk> ChunkPtr;
+
+	// A run of tokens in the final order
+	struct Piece {
+		const Token* tokens;
+		size_t count;
+		const uint32_t* remap; // chunk ids to global ids, 0 if global
+		size_t output; // index in the result
+	};
+
+	void split();
+	void lexChunk(Chunk& chunk);
+	void stitch();
+	void splice(Chunk& chunk, size_t index);
+	void endRun();
+	void copy(std::vector<Token>& tokens, size_t begin, size_t end) const;
+
+	Context& context;
+	const SourceManager::FileId file;
+	const size_t size;
+	const Location base;
+
+	unsigned threads;
+	const size_t minChunkSize;
+
+	std::vector<ChunkPtr> chunks;
+	std::vector<Piece> pieces;
+
+	// Tokens that had to be relexed serially
+	std::list<std::vector<Token> > runs;
+};
+
+} // namespace lexer
+} // namespace llang
+
+#endif
@@ -42,12 +42,15 @@ const char* Token::typeToString(Token::Type type) {
 }
 
 std::ostream& operator<<(std::ostream& os, const Token& token) {
-	os << token.location << ":" << Token::typeToString(token.type);
+	os << "@" << token.location.offset << ":"
+	   << Token::typeToString(token.type);
 
 	if (token.type == Token::NUMBER)
-		os << ":" << token.number;
+		os << ":" << token.number();
 	else if (token.type == Token::IDENTIFIER)
-		os << ":" << token.identifier;
+		os << ":#" << token.identifier().id();
+	else if (token.type == Token::STRING)
+		os << ":" << token.length << " bytes";
 
 	return os;
 }
@@ -2,6 +2,8 @@
 #define LLANG_LEXER_TOKEN_HPP_INCLUDED
 
 #include <iostream>
+#include <cassert>
+#include <stdint.h>
 
 #include "common/number.hpp"
 #include "common/identifier.hpp"
@@ -10,10 +12,11 @@
 namespace llang {
 namespace lexer {
 
+// Tokens are plain 16 byte values referring back into the source buffer.
+// Identifiers carry their interned id; string literals are decoded on demand
+// by the lexer (see Lexer::stringValue).
 struct Token {
-	const Location location;
-
-	const enum Type {
+	enum Type {
 		NUMBER,
 		LPAREN,
 		RPAREN,
@@ -48,29 +51,43 @@ struct Token {
 		KEYWORD_ARRAY,
 
 		ENUM_MAX
-	} type;
+	};
+
+	Location location; // of the first character
+	uint32_t length; // in bytes
+	Type type;
+	// NUMBER: the number, IDENTIFIER: the identifier's id,
+	// STRING: 1 if the literal contains escape sequences
+	uint32_t value;
 
-	const int_t number; // set if type == NUMBER
-	const identifier_t identifier; // set if type == IDENTIFIER
+	// Uninitialized, for arrays that are filled in later
+	Token() {}
 
-	Token(const Location& location, Type type)
-		: location(location), type(type), number(-666), identifier("error") {
+	Token(const Location& location, Type type, uint32_t length,
+	      uint32_t value = 0)
+		: location(location), length(length), type(type), value(value) {
 	}
 
-	Token(const Location& location, const int_t& number)
-		: location(location), type(NUMBER), number(number),
-		  identifier("error") {
+	int_t number() const {
+		assert(type == NUMBER);
+		return static_cast<int_t>(value);
 	}
 
-	Token(const Location& location, const identifier_t& identifier,
-	      Type type = IDENTIFIER)
-		: location(location), type(type), number(-666),
-		  identifier(identifier) {
+	identifier_t identifier() const {
+		assert(type == IDENTIFIER);
+		return identifier_t(value);
+	}
+
+	bool hasEscapes() const {
+		assert(type == STRING);
+		return value != 0;
 	}
 
 	static const char* typeToString(Type type);
 };
 
+static_assert(sizeof(Token) <= 16, "tokens should stay small");
+
 std::ostream& operator<<(std::ostream& os, const Token& token);
 
 } // namespace lexer
@@ -1,7 +1,7 @@
 #ifndef LLANG_LEXER_TOKEN_STREAM_HPP_INCLUDED
 #define LLANG_LEXER_TOKEN_STREAM_HPP_INCLUDED
 
-#include <deque>
+#include <vector>
 #include <cassert>
 
 #include "lexer/lexer.hpp"
@@ -11,47 +11,131 @@ namespace lexer {
 
 class TokenStream {
 public:
-	TokenStream(Lexer& lexer)
-		: lexer(lexer) {
-		addOneToken();
+	enum Mode {
+		// Lex the whole file up front into one array. peek and next are
+		// plain index arithmetic.
+		PRELEXED,
+
+		// Lex on demand, keeping only a small window of tokens. For inputs
+		// that are too big to hold all tokens at once.
+		STREAMING,
+
+		// Lex on demand, but keep all tokens. For parsing only a part of a
+		// file.
+		LAZY
+	};
+
+	TokenStream(Lexer& lexer, Mode mode = PRELEXED)
+		: lexer_(lexer), mode(mode), position(0) {
+		if (mode == PRELEXED)
+			lexAll();
+		else
+			addOneToken();
+	}
+
+	// Takes over tokens lexed elsewhere (e.g. by ParallelLexer), which must
+	// end with END_OF_FILE. The lexer is still used for stringValue.
+	TokenStream(Lexer& lexer, std::vector<Token>& tokens)
+		: lexer_(lexer), mode(PRELEXED), position(0) {
+		assert(!tokens.empty() && tokens.back().type == Token::END_OF_FILE);
+		this->tokens.swap(tokens);
 	}
 
 	const Token& get() const {
-		assert(tokens.size() > 0);
-		return tokens.front();
+		assert(position < tokens.size());
+		return tokens[position];
 	}
 
 	const Token& next() {
-		if (tokens.size() > 0) tokens.pop_front();
-		if (tokens.size() < 1) addOneToken();
+		if (mode == PRELEXED) {
+			// Stay on END_OF_FILE once it's reached
+			if (position + 1 < tokens.size()) ++position;
+			return get();
+		}
+
+		++position;
+		if (position == tokens.size()) refill();
 		return get();
 	}
 
 	const Token& peek(const size_t distance = 1) {
 		assert(distance >= 1);
 
-		if (tokens.size() <= distance) {
-			size_t delta = distance - tokens.size();
-			for (size_t i = 0; i <= delta; ++i) {
-				addOneToken();
-			}
+		if (mode == PRELEXED) {
+			// Like next, peeking past the end gives END_OF_FILE
+			if (position + distance >= tokens.size())
+				return tokens.back();
 
-			assert(tokens.size() == distance + 1);
+			return tokens[position + distance];
 		}
 
-		return tokens[distance];
+		while (tokens.size() <= position + distance)
+			addOneToken();
+
+		return tokens[position + distance];
+	}
+
+	// Index of the current token and all tokens lexed so far, in PRELEXED
+	// and LAZY mode
+	size_t index() const {
+		assert(mode != STREAMING);
+		return position;
+	}
+
+	const std::vector<Token>& all() const {
+		assert(mode != STREAMING);
+		return tokens;
+	}
+
+	// Hands all tokens over to the caller, in PRELEXED and LAZY mode once
+	// END_OF_FILE has been reached. The stream can't be used after that.
+	void releaseTokens(std::vector<Token>& out) {
+		assert(mode != STREAMING);
+		assert(tokens.back().type == Token::END_OF_FILE);
+		out.swap(tokens);
+		tokens.clear();
+	}
+
+	StringLiteral stringValue(const Token& token) {
+		return lexer_.stringValue(token);
 	}
 
+	Lexer& lexer() const { return lexer_; }
+
 private:
-	Lexer& lexer;
+	Lexer& lexer_;
+	const Mode mode;
+
+	std::vector<Token> tokens;
+	size_t position; // index of the current token in tokens
+
+	// Source bytes per token are around 4 to 5 in typical code, so this
+	// rarely needs to grow
+	static const size_t bytesPerToken = 4;
 
-	void addOneToken() { tokens.push_back(lexer.lexToken()); }
+	// Consumed tokens are dropped once this many have accumulated
+	static const size_t windowSize = 1024;
 
-	std::deque<Token> tokens;
+	void addOneToken() { tokens.push_back(lexer_.lexToken()); }
+
+	void lexAll() {
+		tokens.reserve(lexer_.sourceSize() / bytesPerToken + 1);
+
+		do addOneToken();
+		while (tokens.back().type != Token::END_OF_FILE);
+	}
+
+	void refill() {
+		if (mode == STREAMING && position >= windowSize) {
+			tokens.erase(tokens.begin(), tokens.begin() + position);
+			position = 0;
+		}
+
+		addOneToken();
+	}
 };
 
 } // namespace lexer
 } // namespace llang
 
 #endif
-
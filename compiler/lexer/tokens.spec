@@ -0,0 +1,49 @@
+# Token specification the lexer's DFA is generated from (see gen_dfa.py).
+# Lines starting with # are comments.
+#
+# Runs of identifiers, numbers and string literals are only recognized by
+# their first character here, the lexer scans the rest by hand:
+#
+#     <run> <characters>
+#
+# Operators are matched by longest match:
+#
+#     "<text>" <Token::Type>
+#
+# Keywords are looked up after an identifier has been scanned:
+#
+#     keyword <text> <Token::Type>
+
+identifier  A-Z a-z _
+number      0-9
+string      "
+end         \0
+
+"("  LPAREN
+")"  RPAREN
+"="  EQUALS
+";"  SEMICOLON
+","  COMMA
+"{"  LBRACE
+"}"  RBRACE
+"+"  PLUS
+"*"  STAR
+"-"  MINUS
+"/"  SLASH
+"["  LBRACKET
+"]"  RBRACKET
+
+keyword fn      KEYWORD_FN
+keyword var     KEYWORD_VAR
+keyword if      KEYWORD_IF
+keyword else    KEYWORD_ELSE
+keyword i32     KEYWORD_I32
+keyword int     KEYWORD_INT
+keyword void    KEYWORD_VOID
+keyword string  KEYWORD_STRING
+keyword char    KEYWORD_CHAR
+keyword bool    KEYWORD_BOOL
+keyword true    KEYWORD_TRUE
+keyword false   KEYWORD_FALSE
+keyword extern  KEYWORD_EXTERN
+keyword arr     KEYWORD_ARRAY
@@ -1,70 +1,202 @@
+#include <cassert>
+#include <cstdio>
 #include <iostream>
-#include <sstream>
-#include <fstream>
 #include <stdexcept>
 
 #include "util/smart_ptr.hpp"
 #include "common/diagnostics.hpp"
+#include "common/trace.hpp"
+#include "common/trace_events.hpp"
 #include "common/config.hpp"
 #include "common/context.hpp"
+#include "common/source_manager.hpp"
 
-#include "lexer/lexer.hpp"
-#include "lexer/token_stream.hpp"
+#include "lexer/parallel_lexer.hpp"
 
 #include "ast/decl.hpp"
 #include "ast/type.hpp"
 #include "ast/expr.hpp"
-#include "parser/parser.hpp"
+#include "parser/parallel_parser.hpp"
 
 #include "semantic/phase1/visitors.hpp"
 #include "semantic/phase2/visitors.hpp"
+#include "semantic/body_queue.hpp"
+
+#include "cache/module_cache.hpp"
+
+#include "driver/pass_manager.hpp"
 
 #include "codegen/llvm/codegen.hpp"
 
 using namespace llang;
 
-int main(int argc, const char** argv) {
-	std::string filename;
-	if (argc == 1)
-		filename = "test.llang";
-	else if (argc == 2)
-		filename = argv[1];
-	else
-		throw std::runtime_error("wrong number of parameters");
+namespace {
+
+// What the passes of a compiler run work on
+struct Compilation {
+	Compilation(Context& context, const std::string& filename,
+	            SourceManager::FileId file)
+		: context(context), filename(filename), file(file),
+		  phase1(semantic::makePhase1Visitors(context)),
+		  phase2(semantic::makePhase2Visitors(context)),
+		  bodies(context, *phase1, *phase2) {
+		state.bodies = &bodies;
+	}
 
-	std::string code;
+	Context& context;
+	const std::string filename;
+	const SourceManager::FileId file;
 
-	{
-		std::fstream ifs(filename.c_str());
+	// Only set with --cache, and not for stdin
+	scoped_ptr<cache::ModuleCache> moduleCache;
 
-		if (ifs.fail())
-			throw std::runtime_error("couldn't read file " + filename);
+	std::vector<lexer::Token> tokens;
 
-		std::stringstream oss;
-		oss << ifs.rdbuf();
-		code = oss.str();
-	}
+	// Owns all nodes, including the ones created by the semantic passes
+	scoped_ptr<ast::Module> module;
 
-	Config config;
-	Diagnostics diag(config);
-	Context context(config, diag);
+	scoped_ptr<semantic::Visitors> phase1, phase2;
+	semantic::BodyQueue bodies;
+	semantic::ScopeState state;
+};
 
-	lexer::Lexer lexer(context, filename, code);
-	lexer::TokenStream ts(lexer);
+void loadCache(Compilation& compilation) {
+	compilation.module.reset(compilation.moduleCache->load());
+}
+
+void lex(Compilation& compilation) {
+	// Big files are lexed on all cores
+	lexer::ParallelLexer(compilation.context, compilation.file).lexAll(
+		compilation.tokens);
+}
 
-	parser::Parser parser(context, filename, ts);
-	ast::DeclPtr module(parser.parseModule());
+void parse(Compilation& compilation) {
+	// And parsed on all cores
+	compilation.module.reset(parser::ParallelParser(compilation.context,
+		compilation.filename, compilation.file, compilation.tokens)
+		.parseModule());
 	//print(*module);
+}
 
-	scoped_ptr<semantic::Visitors>
-		phase1(semantic::makePhase1Visitors(context)),
-		phase2(semantic::makePhase2Visitors(context));
-	semantic::ScopeState state;
+void runPhase1(Compilation& compilation) {
+	ast::DeclPtr root = compilation.module.get();
+	root = compilation.phase1->declVisitor->accept(root, compilation.state);
+	assert(root == compilation.module.get());
+}
+
+void runPhase2(Compilation& compilation) {
+	ast::DeclPtr root = compilation.module.get();
+	root = compilation.phase2->declVisitor->accept(root, compilation.state);
+	assert(root == compilation.module.get());
+}
 
-	module = phase1->declVisitor->accept(module, state);
-	module = phase2->declVisitor->accept(module, state);
+// Bodies skipped with --lazy-bodies, as far as they are used
+void analyzeBodies(Compilation& compilation) {
+	compilation.bodies.run(*compilation.module);
+}
+
+void storeCache(Compilation& compilation) {
+	compilation.moduleCache->store(*compilation.module);
+}
 
-	codegen::Codegen gen(context,
-		ast::assumeIsA<ast::Module>(module));
+void generateCode(Compilation& compilation) {
+	codegen::Codegen gen(compilation.context, compilation.module.get());
 	gen.run();
 }
+
+class CompilationPass : public driver::Pass {
+public:
+	typedef void (*Function)(Compilation&);
+
+	CompilationPass(const char* name, Function function,
+	                Compilation& compilation)
+		: name_(name), function(function), compilation(compilation) {
+	}
+
+	virtual const char* name() const { return name_; }
+	virtual void run() { function(compilation); }
+
+private:
+	const char* name_;
+	Function function;
+	Compilation& compilation;
+};
+
+} // namespace
+
+int main(int argc, const char** argv) {
+	Config config;
+	std::string filename = "test.llang";
+	bool haveFilename = false;
+	bool useCache = false;
+	bool timePasses = false;
+
+	for (int i = 1; i < argc; ++i) {
+		const std::string arg = argv[i];
+
+		// --trace=parse,closure (see common/trace.hpp)
+		if (arg.compare(0, 8, "--trace=") == 0) {
+			if (!trace::enable(arg.c_str() + 8))
+				throw std::runtime_error("unknown trace category, or "
+				                         "tracing not compiled in: " + arg);
+		} else if (arg.compare(0, 13, "--trace-json=") == 0) {
+			// Chrome trace events (see common/trace_events.hpp)
+			if (!trace::openEvents(arg.c_str() + 13))
+				throw std::runtime_error("cannot open trace file: " + arg);
+		} else if (arg == "--cache") {
+			useCache = true;
+		} else if (arg == "--time-passes") {
+			timePasses = true;
+		} else if (arg == "--lazy-bodies") {
+			config.lazyFunctionBodies = true;
+		} else if (!haveFilename) {
+			filename = arg;
+			haveFilename = true;
+		} else {
+			throw std::runtime_error("wrong number of parameters");
+		}
+	}
+
+	SourceManager sources;
+	Diagnostics diag(config, sources);
+	Context context(config, diag, sources);
+
+	// "-" reads the source from stdin
+	SourceManager::FileId file = sources.loadFile(filename);
+
+	Compilation compilation(context, filename, file);
+	driver::PassManager passes(timePasses);
+
+	// With --cache, an unchanged file goes straight to codegen. Files read
+	// from stdin aren't cached.
+	if (useCache && filename != "-") {
+		compilation.moduleCache.reset(new cache::ModuleCache(context, file));
+
+		passes.add(new CompilationPass("cache load", loadCache, compilation));
+		passes.run();
+	}
+
+	if (!compilation.module) {
+		passes.add(new CompilationPass("lexer", lex, compilation));
+		passes.add(new CompilationPass("parser", parse, compilation));
+		passes.add(new CompilationPass("phase 1", runPhase1, compilation));
+		passes.add(new CompilationPass("phase 2", runPhase2, compilation));
+
+		if (config.lazyFunctionBodies) {
+			passes.add(new CompilationPass("lazy bodies", analyzeBodies,
+			                               compilation));
+		}
+
+		if (compilation.moduleCache) {
+			passes.add(new CompilationPass("cache store", storeCache,
+			                               compilation));
+		}
+	}
+
+	passes.add(new CompilationPass("codegen", generateCode, compilation));
+	passes.run();
+
+	// The IR goes to stderr (see compile.sh), keep the report out of it
+	passes.printReport(stdout);
+	trace::closeEvents();
+}
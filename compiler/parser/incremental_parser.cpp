@@ -0,0 +1,334 @@
+#include <algorithm>
+#include <cassert>
+
+#include "ast/type.hpp"
+#include "ast/decl.hpp"
+#include "ast/expr.hpp"
+#include "common/trace.hpp"
+#include "lexer/lexer.hpp"
+#include "lexer/parallel_lexer.hpp"
+#include "parser/parser.hpp"
+#include "parser/incremental_parser.hpp"
+
+namespace llang {
+namespace parser {
+
+using namespace ast;
+using namespace lexer;
+
+IncrementalParser::IncrementalParser(Context& context,
+                                     const std::string& moduleName)
+	: context(context), moduleName(moduleName), file_(0), valid(false),
+	  endOfFileVersion(0), cursor(segments.end()), cursorStart(0),
+	  cursorIndex(0) {
+}
+
+ModulePtr IncrementalParser::parse(SourceManager::FileId file) {
+	// Versions of an earlier file are left to the SourceManager
+	versions.clear();
+	endOfFile = Token();
+
+	return parseFrom(file);
+}
+
+ModulePtr IncrementalParser::parseFrom(SourceManager::FileId file) {
+	file_ = file;
+	valid = false;
+
+	dropSegments(segments.begin(), segments.end());
+	cursor = segments.end();
+	cursorStart = 0;
+	cursorIndex = 0;
+
+	std::vector<Token> tokens;
+	ParallelLexer(context, file).lexAll(tokens);
+
+	Lexer lexer(context, file);
+	TokenStream ts(lexer, tokens);
+	Parser parser(context, moduleName, ts);
+
+	module_.reset(parser.makeModule(ts.get().location));
+
+	reparse(file, ts, parser, segments.end(), 0, 0, 0);
+
+	valid = true;
+	return module_.get();
+}
+
+ModulePtr IncrementalParser::update(const Edit& edit) {
+	SourceManager& sources = context.sources;
+	assert(edit.offset + edit.removed <= sources.size(file_));
+
+	SourceManager::FileId file = sources.addVersion(file_, edit.offset,
+		edit.removed, edit.inserted.data(), edit.inserted.size());
+	const size_t size = sources.size(file);
+
+	try {
+		// The declaration containing the byte before the edit is the first
+		// one that might change: the edit could extend its last token.
+		if (valid)
+			seek(static_cast<uint32_t>(edit.offset == 0 ? 0 : edit.offset - 1));
+
+		if (!valid || cursor == segments.end()) {
+			sources.setWindow(file, 0, size);
+			parseFrom(file);
+		} else {
+			// Declarations start with a token, so the lexer can start there.
+			// Only the part that is likely to change is copied out of the
+			// text; if the declarations turn out to change further on, the
+			// lexer runs into the end of the window and we start over with
+			// a bigger one.
+			size_t end = windowEnd(edit);
+
+			for (;;) {
+				sources.setWindow(file, cursorStart, end);
+
+				try {
+					Lexer lexer(context, file, cursorStart,
+					            context.identifiers, false);
+					TokenStream ts(lexer, TokenStream::LAZY);
+					Parser parser(context, moduleName, ts);
+
+					reparse(file, ts, parser, cursor, cursorIndex, cursorStart,
+					        &edit);
+					break;
+				} catch (const EndOfWindow&) {
+					end = std::min(size,
+						cursorStart + 2 * (end - cursorStart) + 1);
+					LLANG_TRACE(PARSE, "growing the window to offset %zu", end);
+				}
+			}
+		}
+	} catch (...) {
+		// The text changed anyway, start from scratch next time
+		file_ = file;
+		valid = false;
+		releaseVersions();
+		throw;
+	}
+
+	file_ = file;
+	releaseVersions();
+	return module_.get();
+}
+
+// Where the lexer's window for the edit ends in the new version: after the
+// first two old declarations starting past the edit, as the reparse usually
+// stops at one of them
+size_t IncrementalParser::windowEnd(const Edit& edit) const {
+	const size_t editEnd = edit.offset + edit.removed;
+
+	SegmentList::const_iterator segment = cursor;
+	size_t start = cursorStart; // of the segment, in the old version
+	unsigned past = 0;
+
+	for (; segment != segments.end() && past < 2; ++segment) {
+		if (start >= editEnd)
+			++past;
+
+		start += segment->length;
+	}
+
+	return start - edit.removed + edit.inserted.size();
+}
+
+// Parses declarations from start (in the new version) on, replacing the
+// segments from first (the firstIndex-th) on. Without an edit, parses to the
+// end of the file.
+void IncrementalParser::reparse(SourceManager::FileId file, TokenStream& ts,
+                                Parser& parser, SegmentList::iterator first,
+                                size_t firstIndex, uint32_t start,
+                                const Edit* edit) {
+	// Where offset 0 of the version would be, offsets are relative to it
+	// (wrapping around if the window starts further in)
+	const size_t bufferOffset = context.sources.bufferOffset(file);
+	const uint32_t base = context.sources.location(file, bufferOffset).offset -
+		static_cast<uint32_t>(bufferOffset);
+	const uint32_t size = static_cast<uint32_t>(context.sources.size(file));
+
+	const uint32_t editEnd = edit ?
+		static_cast<uint32_t>(edit->offset + edit->inserted.size()) : 0;
+	const uint32_t removed = edit ? static_cast<uint32_t>(edit->removed) : 0;
+	const uint32_t inserted =
+		edit ? static_cast<uint32_t>(edit->inserted.size()) : 0;
+
+	// The first old segment that is kept, where it started in the old
+	// version and its index
+	SegmentList::iterator old = first;
+	uint32_t oldStart = start;
+	size_t oldIndex = firstIndex;
+	bool synced = false;
+
+	Module::DeclList decls;
+	std::vector<size_t> starts; // index of the first token of each decl
+
+	while (ts.get().type != Token::END_OF_FILE) {
+		const uint32_t offset = ts.get().location.offset - base;
+
+		// Past the edit the text is the same as before, so if an old
+		// declaration started here, it and everything after it is unchanged
+		if (edit && offset >= editEnd) {
+			const uint32_t target = offset + removed - inserted;
+
+			while (old != segments.end() && oldStart < target) {
+				oldStart += old->length;
+				++old;
+				++oldIndex;
+			}
+
+			if (old != segments.end() && oldStart == target) {
+				synced = true;
+				break;
+			}
+		}
+
+		starts.push_back(ts.index());
+		decls.push_back(parser.parseTopLevelDecl(module_->arena));
+	}
+
+	LLANG_TRACE(PARSE, "reparsed %zu decls from offset %u, %s",
+	            decls.size(), start, synced ? "synced" : "to the end");
+
+	if (!synced) {
+		old = segments.end();
+		oldIndex = module_->decls.size();
+
+		if (endOfFile.location.isValid())
+			--versions[endOfFileVersion];
+
+		endOfFile = ts.get();
+		endOfFileVersion = file;
+		++versions[file];
+	}
+
+	const uint32_t end = synced ? ts.get().location.offset - base : size;
+	const std::vector<Token>& tokens = ts.all();
+	const size_t endIndex = ts.index();
+
+	// Build the new segments
+	SegmentList fresh;
+	for (size_t i = 0; i < starts.size(); ++i) {
+		const bool last = i + 1 == starts.size();
+
+		const uint32_t from = i == 0 ? start :
+			tokens[starts[i]].location.offset - base;
+		const uint32_t to = last ? end :
+			tokens[starts[i + 1]].location.offset - base;
+
+		fresh.push_back(Segment());
+		Segment& segment = fresh.back();
+		segment.length = to - from;
+		segment.version = file;
+		segment.tokens.assign(tokens.begin() + starts[i],
+		                      tokens.begin() + (last ? endIndex : starts[i + 1]));
+	}
+
+	// Replace the old declarations in the module. Only a difference in
+	// their number shifts the ones after them.
+	Module::DeclList& moduleDecls = module_->decls;
+	const size_t common = std::min(oldIndex - firstIndex, decls.size());
+	std::copy(decls.begin(), decls.begin() + common,
+	          moduleDecls.begin() + firstIndex);
+
+	if (common < decls.size()) {
+		moduleDecls.insert(moduleDecls.begin() + firstIndex + common,
+		                   decls.begin() + common, decls.end());
+	} else {
+		moduleDecls.erase(moduleDecls.begin() + firstIndex + common,
+		                  moduleDecls.begin() + oldIndex);
+	}
+
+	// And the segments
+	const bool atBegin = first == segments.begin();
+	SegmentList::iterator previous = first;
+	if (!atBegin) --previous;
+
+	dropSegments(first, old);
+	versions[file] += fresh.size();
+
+	if (!fresh.empty()) {
+		cursor = fresh.begin();
+		cursorStart = start;
+		cursorIndex = firstIndex;
+		segments.splice(old, fresh);
+	} else if (!atBegin) {
+		// Nothing left between the neighbours, the previous declaration
+		// takes the space
+		cursor = previous;
+		cursorStart = start - previous->length;
+		cursorIndex = firstIndex - 1;
+		previous->length += end - start;
+	} else {
+		cursor = segments.begin();
+		cursorStart = 0;
+		cursorIndex = 0;
+		if (cursor != segments.end())
+			cursor->length += end - start;
+	}
+}
+
+// Moves the cursor to the segment containing offset
+void IncrementalParser::seek(uint32_t offset) {
+	if (segments.empty()) {
+		cursor = segments.end();
+		return;
+	}
+
+	if (cursor == segments.end()) {
+		cursor = segments.begin();
+		cursorStart = 0;
+		cursorIndex = 0;
+	}
+
+	while (cursorStart > offset) {
+		--cursor;
+		cursorStart -= cursor->length;
+		--cursorIndex;
+	}
+
+	for (;;) {
+		SegmentList::iterator next = cursor;
+		++next;
+
+		if (next == segments.end() || offset < cursorStart + cursor->length)
+			break;
+
+		cursorStart += cursor->length;
+		cursor = next;
+		++cursorIndex;
+	}
+}
+
+void IncrementalParser::dropSegments(SegmentList::iterator first,
+                                     SegmentList::iterator last) {
+	for (SegmentList::iterator segment = first; segment != last; ++segment)
+		--versions[segment->version];
+
+	segments.erase(first, last);
+}
+
+// Releases the versions no segment uses any more, except the newest
+void IncrementalParser::releaseVersions() {
+	for (VersionMap::iterator i = versions.begin(); i != versions.end();) {
+		if (i->second || i->first == file_) {
+			++i;
+			continue;
+		}
+
+		context.sources.release(i->first);
+		versions.erase(i++);
+	}
+}
+
+void IncrementalParser::tokens(std::vector<Token>& out) const {
+	out.clear();
+
+	for (SegmentList::const_iterator segment = segments.begin();
+	     segment != segments.end(); ++segment)
+		out.insert(out.end(), segment->tokens.begin(), segment->tokens.end());
+
+	out.push_back(endOfFile);
+}
+
+} // namespace parser
+} // namespace llang
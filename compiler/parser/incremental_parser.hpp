@@ -0,0 +1,120 @@
+#ifndef LLANG_PARSER_INCREMENTAL_PARSER_HPP_INCLUDED
+#define LLANG_PARSER_INCREMENTAL_PARSER_HPP_INCLUDED
+
+#include <list>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "util/smart_ptr.hpp"
+#include "common/context.hpp"
+#include "common/source_manager.hpp"
+#include "lexer/token.hpp"
+#include "lexer/token_stream.hpp"
+#include "ast/decl.hpp"
+
+namespace llang {
+namespace parser {
+
+class Parser;
+
+// Replaces [offset, offset + removed) with inserted
+struct Edit {
+	size_t offset;
+	size_t removed;
+	std::string inserted;
+};
+
+// Keeps the tokens and the syntax tree of a file up to date while it is
+// being edited.
+//
+// Every top-level declaration is kept together with its tokens and its
+// length in bytes, in a segment. The n-th segment holds the n-th declaration
+// of the Module. An edit relexes and reparses from the declaration
+// containing it until the parser reaches a declaration starting where an
+// old one did, past the edit. The other declarations, their tokens and the
+// Module are kept as they are, and their locations stay in the version they
+// were lexed in (see SourceManager::addVersion). Only the relexed part of
+// the new version is copied out of the text and uses up location space, and
+// versions are released once none of their declarations is left. Apart from
+// shifting the Module's array of declarations, an edit only does work
+// proportional to the damaged declarations and the distance to the previous
+// edit.
+//
+// The trees are parse trees: the semantic passes rewrite nodes in place, so
+// they should only be run on a tree that won't be updated any more. Replaced
+// declarations stay in the module's arena until the next full parse, but
+// their locations can't be decoded any more.
+class IncrementalParser {
+public:
+	IncrementalParser(Context& context, const std::string& moduleName);
+
+	// Lexes and parses the file from scratch. The module is owned by the
+	// parser and stays valid until the next full parse.
+	ast::ModulePtr parse(SourceManager::FileId file);
+
+	// Applies the edit to the current version of the file, adding the new
+	// version to the SourceManager and releasing the ones that aren't used
+	// any more. If lexing or parsing fails, the error is reported as usual
+	// and the next update starts from scratch.
+	ast::ModulePtr update(const Edit& edit);
+
+	SourceManager::FileId file() const { return file_; }
+	ast::ModulePtr module() const { return module_.get(); }
+
+	// All tokens in order, ending with END_OF_FILE
+	void tokens(std::vector<lexer::Token>& out) const;
+
+private:
+	struct Segment {
+		// From the first token of the declaration to the first one of the
+		// next (from the start of the file for the first declaration, to its
+		// end for the last)
+		uint32_t length;
+
+		std::vector<lexer::Token> tokens;
+		SourceManager::FileId version; // the tokens were lexed in
+	};
+
+	typedef std::list<Segment> SegmentList;
+
+	// Number of segments (and END_OF_FILE) lexed in each version that isn't
+	// released yet
+	typedef std::map<SourceManager::FileId, size_t> VersionMap;
+
+	ast::ModulePtr parseFrom(SourceManager::FileId file);
+
+	size_t windowEnd(const Edit& edit) const;
+
+	void reparse(SourceManager::FileId file, lexer::TokenStream& ts,
+	             Parser& parser, SegmentList::iterator first,
+	             size_t firstIndex, uint32_t start, const Edit* edit);
+
+	void seek(uint32_t offset);
+
+	void dropSegments(SegmentList::iterator first,
+	                  SegmentList::iterator last);
+	void releaseVersions();
+
+	Context& context;
+	const std::string moduleName;
+
+	SourceManager::FileId file_;
+	bool valid; // false after a failed update
+
+	scoped_ptr<ast::Module> module_;
+	SegmentList segments;
+	lexer::Token endOfFile;
+	SourceManager::FileId endOfFileVersion;
+	VersionMap versions;
+
+	// Where the last edit was, the offset it starts at and its index
+	SegmentList::iterator cursor;
+	uint32_t cursorStart;
+	size_t cursorIndex;
+};
+
+} // namespace parser
+} // namespace llang
+
+#endif
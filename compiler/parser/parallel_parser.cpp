@@ -0,0 +1,187 @@
+#include <algorithm>
+#include <cassert>
+#include <functional>
+#include <thread>
+
+#include "common/trace.hpp"
+#include "lexer/lexer.hpp"
+#include "lexer/token_stream.hpp"
+#include "ast/type.hpp"
+#include "ast/expr.hpp"
+#include "parser/parser.hpp"
+#include "parser/parallel_parser.hpp"
+
+namespace llang {
+namespace parser {
+
+using namespace ast;
+using namespace lexer;
+
+struct ParallelParser::Chunk {
+	size_t begin, end; // token indices
+
+	Arena arena;
+	Module::DeclList decls;
+
+	// Index of the token after the last declaration in decls. If failed,
+	// the next declaration has an error.
+	size_t parsed;
+	bool failed;
+
+	Chunk(size_t begin, size_t end)
+		: begin(begin), end(end), parsed(begin), failed(false) {
+	}
+};
+
+ParallelParser::ParallelParser(Context& context,
+                               const std::string& moduleName,
+                               SourceManager::FileId file,
+                               std::vector<Token>& tokens,
+                               unsigned threads, size_t minChunkTokens)
+	: context(context), moduleName(moduleName), file(file), tokens(tokens),
+	  threads(threads), minChunkTokens(minChunkTokens) {
+	assert(!tokens.empty() && tokens.back().type == Token::END_OF_FILE);
+
+	if (this->threads == 0)
+		this->threads = std::max(1u, std::thread::hardware_concurrency());
+}
+
+ModulePtr ParallelParser::parseModule() {
+	// Skipping bodies (Config::lazyFunctionBodies) is a scan that's not
+	// worth splitting up
+	if (context.config.lazyFunctionBodies || !split())
+		return parseSerially(0, 0);
+
+	LLANG_TRACE(PARSE, "%zu tokens in %zu chunks", tokens.size(),
+	            chunks.size());
+
+	std::vector<std::thread> workers;
+	for (size_t i = 0; i < chunks.size(); ++i)
+		workers.push_back(std::thread(&ParallelParser::parseChunk, this,
+		                              std::ref(*chunks[i])));
+	for (size_t i = 0; i < workers.size(); ++i)
+		workers[i].join();
+
+	ModulePtr module = new Module(tokens.front().location,
+	                              context.identifiers.intern(moduleName));
+
+	size_t count = 0;
+	for (size_t i = 0; i < chunks.size(); ++i)
+		count += chunks[i]->decls.size();
+	module->decls.reserve(count);
+
+	for (size_t i = 0; i < chunks.size(); ++i) {
+		Chunk& chunk = *chunks[i];
+
+		module->arena.adopt(chunk.arena);
+		module->decls.insert(module->decls.end(), chunk.decls.begin(),
+		                     chunk.decls.end());
+
+		// Everything up to here is what the serial parser would have
+		// produced, so it would have got to the error the same way
+		if (chunk.failed) {
+			LLANG_TRACE(PARSE, "chunk %zu failed, parsing serially from "
+			            "token %zu", i, chunk.parsed);
+			return parseSerially(chunk.parsed, module);
+		}
+	}
+
+	return module;
+}
+
+// Groups declarations into chunks of about equal size. Only the first chunk
+// is known to start with a declaration: braces might not be balanced. But a
+// chunk is only used if the one before it was parsed to its end without
+// errors, and then it starts where the serial parser would continue.
+bool ParallelParser::split() {
+	const size_t size = tokens.size() - 1; // without END_OF_FILE
+
+	const size_t count = std::max<size_t>(1,
+		std::min<size_t>(threads, size / minChunkTokens));
+
+	size_t begin = 0;
+	size_t i = 0;
+	int depth = 0;
+
+	for (size_t c = 1; c < count; ++c) {
+		const size_t target = size * c / count;
+
+		// The chunk ends after the first ';' outside of braces from target
+		// on
+		bool found = false;
+		for (; i < size && !found; ++i) {
+			switch (tokens[i].type) {
+			case Token::LBRACE: ++depth; break;
+			case Token::RBRACE: --depth; break;
+			case Token::SEMICOLON: found = depth == 0 && i >= target; break;
+			default: break;
+			}
+		}
+
+		if (!found || i == size) break;
+
+		chunks.push_back(ChunkPtr(new Chunk(begin, i)));
+		begin = i;
+	}
+
+	chunks.push_back(ChunkPtr(new Chunk(begin, size)));
+
+	return chunks.size() > 1;
+}
+
+void ParallelParser::parseChunk(Chunk& chunk) {
+	// The chunk's tokens with an END_OF_FILE, so that the parser stops at
+	// the end of the chunk
+	std::vector<Token> chunkTokens;
+	chunkTokens.reserve(chunk.end - chunk.begin + 1);
+	chunkTokens.insert(chunkTokens.end(), tokens.begin() + chunk.begin,
+	                   tokens.begin() + chunk.end);
+	chunkTokens.push_back(Token(tokens[chunk.end].location,
+	                            Token::END_OF_FILE, 0));
+
+	Lexer lexer(context, file); // for string literals
+	TokenStream ts(lexer, chunkTokens);
+
+	// Errors are reported by the serial parser that takes over
+	Diagnostics quiet(context.config, context.sources, true);
+	Parser parser(context, quiet, moduleName, ts);
+
+	try {
+		while (ts.get().type != Token::END_OF_FILE) {
+			chunk.decls.push_back(parser.parseTopLevelDecl(chunk.arena));
+			chunk.parsed = chunk.begin + ts.index();
+		}
+	} catch (...) {
+		chunk.failed = true;
+	}
+}
+
+// Parses the declarations from token begin on into module, or a new one if
+// module is null
+ModulePtr ParallelParser::parseSerially(size_t begin, ModulePtr module) {
+	std::vector<Token> rest;
+	if (begin == 0)
+		rest.swap(tokens);
+	else
+		rest.assign(tokens.begin() + begin, tokens.end());
+
+	Lexer lexer(context, file);
+	TokenStream ts(lexer, rest);
+	Parser parser(context, moduleName, ts);
+
+	if (!module)
+		return parser.parseModule();
+
+	try {
+		while (ts.get().type != Token::END_OF_FILE)
+			module->decls.push_back(parser.parseTopLevelDecl(module->arena));
+	} catch (...) {
+		delete module;
+		throw;
+	}
+
+	return module;
+}
+
+} // namespace parser
+} // namespace llang
@@ -0,0 +1,67 @@
+#ifndef LLANG_PARSER_PARALLEL_PARSER_HPP_INCLUDED
+#define LLANG_PARSER_PARALLEL_PARSER_HPP_INCLUDED
+
+#include <string>
+#include <vector>
+
+#include <boost/shared_ptr.hpp>
+
+#include "common/context.hpp"
+#include "common/source_manager.hpp"
+#include "lexer/token.hpp"
+#include "ast/decl.hpp"
+
+namespace llang {
+namespace parser {
+
+// Parses the top-level declarations of a file on several threads.
+//
+// Top-level declarations end with a ';' outside of any braces, so a scan
+// over the tokens finds where they start without parsing them. Consecutive
+// declarations are grouped into chunks, and every chunk is parsed by its
+// own Parser into its own arena, with errors only throwing. The chunks are
+// then taken in order. If one failed, the declarations before the error are
+// kept and the rest of the file is parsed serially from there, reporting the
+// error as usual.
+//
+// The result and the reported error are the same as Parser::parseModule's,
+// however the threads are scheduled. With Config::lazyFunctionBodies the
+// file is always parsed serially.
+class ParallelParser {
+public:
+	// The tokens must end with END_OF_FILE. A file that is parsed serially
+	// takes them over, like TokenStream does.
+	//
+	// threads == 0 uses one thread per core. Chunks are at least
+	// minChunkTokens tokens, smaller files are parsed serially.
+	ParallelParser(Context& context, const std::string& moduleName,
+	               SourceManager::FileId file,
+	               std::vector<lexer::Token>& tokens,
+	               unsigned threads = 0, size_t minChunkTokens = 1 << 18);
+
+	// The caller owns the module
+	ast::ModulePtr parseModule();
+
+private:
+	struct Chunk;
+	typedef boost::shared_ptr<Chunk> ChunkPtr;
+
+	bool split();
+	void parseChunk(Chunk& chunk);
+	ast::ModulePtr parseSerially(size_t begin, ast::ModulePtr module);
+
+	Context& context;
+	const std::string& moduleName;
+	const SourceManager::FileId file;
+	std::vector<lexer::Token>& tokens;
+
+	unsigned threads;
+	const size_t minChunkTokens;
+
+	std::vector<ChunkPtr> chunks;
+};
+
+} // namespace parser
+} // namespace llang
+
+#endif
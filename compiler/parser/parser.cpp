@@ -1,6 +1,7 @@
 #include <cstdarg> 
 #include <cstdio>
 
+#include "common/trace.hpp"
 #include "ast/type.hpp"
 #include "ast/decl.hpp"
 #include "ast/expr.hpp"
@@ -12,21 +13,129 @@ namespace parser {
 using namespace ast;
 using namespace lexer;
 
+namespace {
+
+struct BinaryOperator {
+	int precedence; // 0 if the token isn't a binary operator
+	BinaryExpr::Operation operation;
+};
+
+class BinaryOperatorTable {
+public:
+	BinaryOperatorTable() {
+		for (size_t i = 0; i < Token::ENUM_MAX; ++i)
+			operators[i].precedence = 0;
+
+		add(Token::EQUALS, 1, BinaryExpr::EQUALS);
+		add(Token::PLUS, 2, BinaryExpr::ADD);
+		add(Token::MINUS, 2, BinaryExpr::SUB);
+		add(Token::STAR, 3, BinaryExpr::MUL);
+		add(Token::SLASH, 3, BinaryExpr::DIV);
+	}
+
+	const BinaryOperator& operator[](Token::Type type) const {
+		return operators[type];
+	}
+
+private:
+	void add(Token::Type type, int precedence,
+	         BinaryExpr::Operation operation) {
+		operators[type].precedence = precedence;
+		operators[type].operation = operation;
+	}
+
+	BinaryOperator operators[Token::ENUM_MAX];
+};
+
+const BinaryOperatorTable binaryOperators;
+
+} // namespace
+
+// Owned by the module, keeps its tokens to parse skipped bodies from
+class SkippedBodies : public BodySource {
+public:
+	SkippedBodies(Context& context, const Lexer& lexer,
+	              const std::string& moduleName, Arena& arena)
+		: context(context), lexer(lexer), moduleName(moduleName),
+		  arena(arena) {
+	}
+
+	virtual ExprPtr parseBody(size_t begin, size_t end) {
+		LLANG_TRACE(PARSE, "parsing skipped body, tokens %zu to %zu",
+		            begin, end);
+
+		std::vector<Token> bodyTokens;
+		bodyTokens.reserve(end - begin + 1);
+		bodyTokens.insert(bodyTokens.end(), tokens.begin() + begin,
+		                  tokens.begin() + end);
+		bodyTokens.push_back(Token(tokens[end].location,
+		                           Token::END_OF_FILE, 0));
+
+		TokenStream ts(lexer, bodyTokens);
+		return Parser(context, moduleName, ts).parseBody(arena);
+	}
+
+	std::vector<Token> tokens;
+
+private:
+	Context& context;
+	Lexer lexer; // for string literals
+	const std::string moduleName;
+	Arena& arena;
+};
+
 ModulePtr Parser::parseModule() {
-	Module::DeclList decls;
+	ModulePtr module = makeModule(ts.get().location);
 
-	while (ts.get().type != Token::END_OF_FILE) {
-		decls.push_back(parseDecl());
-		assumeNext(Token::SEMICOLON);
+	if (context.config.lazyFunctionBodies) {
+		bodies = new SkippedBodies(context, ts.lexer(), moduleName,
+		                           module->arena);
+		module->bodySource.reset(bodies);
 	}
 
-	return ModulePtr(new Module(Location(moduleName, 1, 1), moduleName, decls));
+	try {
+		while (ts.get().type != Token::END_OF_FILE)
+			module->decls.push_back(parseTopLevelDecl(module->arena));
+	} catch (...) {
+		bodies = 0;
+		delete module;
+		throw;
+	}
+
+	if (bodies) {
+		ts.releaseTokens(bodies->tokens);
+		bodies = 0;
+	}
+
+	return module;
+}
+
+DeclPtr Parser::parseTopLevelDecl(Arena& arena) {
+	this->arena = &arena;
+
+	DeclPtr decl = parseDecl(true);
+	assumeNext(Token::SEMICOLON);
+
+	return decl;
+}
+
+ExprPtr Parser::parseBody(Arena& arena) {
+	this->arena = &arena;
+
+	ExprPtr body = parseExpr();
+	assume(Token::END_OF_FILE);
+
+	return body;
 }
 
-DeclPtr Parser::parseDecl() {
+ModulePtr Parser::makeModule(const Location& location) {
+	return new Module(location, identifiers.intern(moduleName));
+}
+
+DeclPtr Parser::parseDecl(bool topLevel) {
 	switch (ts.get().type) {
 	case Token::KEYWORD_FN:
-		return parseFunctionDecl();
+		return parseFunctionDecl(topLevel);
 
 	case Token::KEYWORD_VAR:
 		return parseVariableDecl();
@@ -41,7 +150,7 @@ DeclPtr Parser::parseDecl() {
 		if (function->body) {
 			diag.error(function->location(),
 				"extern function '%s' cannot have body",
-				function->name.c_str());
+				identifiers.c_str(function->name));
 		}
 
 		return function;
@@ -57,7 +166,7 @@ DeclPtr Parser::parseDecl() {
 TypePtr Parser::parseType() {
 	Location location = ts.get().location;
 
-	TypePtr type;
+	TypePtr type = 0;
 
 	switch (ts.get().type) {
 	case Token::KEYWORD_I32: {
@@ -84,7 +193,7 @@ TypePtr Parser::parseType() {
 	
 	Cintegral:
 		ts.next();
-		type = TypePtr(new IntegralType(location, kind));
+		type = arena->make<IntegralType>(location, kind);
 		break;
 	}
 
@@ -95,7 +204,7 @@ TypePtr Parser::parseType() {
 	case Token::KEYWORD_ARRAY:
 		ts.next();
 		assumeNext(Token::LBRACKET);
-		type = TypePtr(new ArrayType(location, parseType()));
+		type = arena->make<ArrayType>(location, parseType());
 		assumeNext(Token::RBRACKET);
 
 		break;
@@ -112,7 +221,7 @@ TypePtr Parser::parseType() {
 		//ts.next();
 		//assumeNext(Token::RBRACKET);
 
-		//type = TypePtr(new ArrayType(location, type));
+		//type = arena->make<ArrayType>(location, type);
 	//}
 
 	return type;
@@ -143,22 +252,23 @@ TypePtr Parser::parseFunctionType() {
 
 	assumeNext(Token::RPAREN);
 
-	return TypePtr(new FunctionType(location, returnType, parameters));
+	return arena->make<FunctionType>(location, returnType,
+	                                 std::move(parameters));
 }
 
 ExprPtr Parser::parseExpr() {
 	switch (ts.get().type) {
 	default:
-		return parseAssignExpr();
+		return parseBinaryExpr(1);
 
 	case Token::KEYWORD_FN:
 	case Token::KEYWORD_VAR:
 		const Location location = ts.get().location;
-		return ExprPtr(new DeclExpr(location, parseDecl()));
+		return arena->make<DeclExpr>(location, parseDecl());
 	}
 }
 
-DeclPtr Parser::parseFunctionDecl() {
+DeclPtr Parser::parseFunctionDecl(bool topLevel) {
 	const Location location = ts.get().location;
 
 	TypePtr returnType;
@@ -166,15 +276,63 @@ DeclPtr Parser::parseFunctionDecl() {
 	FunctionDecl::ParameterList parameters;
 	parseFunctionPrototype(returnType, name, parameters);
 
-	ExprPtr body;
+	ExprPtr body = 0;
+	bool skipped = false;
+	size_t bodyBegin = 0, bodyEnd = 0;
 
 	if (ts.get().type == Token::EQUALS) {
 		ts.next();
-		body = parseExpr();
+
+		// Only top-level bodies are skipped, nested functions are parsed
+		// with the body they are in
+		if (topLevel && bodies)
+			skipped = skipBody(bodyBegin, bodyEnd);
+
+		if (!skipped)
+			body = parseExpr();
+	}
+
+	FunctionDeclPtr function = arena->make<FunctionDecl>(location, name,
+		returnType, std::move(parameters), body);
+
+	if (skipped) {
+		function->bodySource = bodies;
+		function->bodyBegin = bodyBegin;
+		function->bodyEnd = bodyEnd;
 	}
 
-	return DeclPtr(new FunctionDecl(location, name, returnType, parameters,
-	                                body));
+	return function;
+}
+
+// Skips a body that is a block directly followed by the declaration's ';',
+// by matching braces. Anything else, unbalanced braces included, is left to
+// be parsed right away.
+bool Parser::skipBody(size_t& begin, size_t& end) {
+	if (ts.get().type != Token::LBRACE)
+		return false;
+
+	size_t distance = 0;
+	int depth = 1;
+
+	while (depth > 0) {
+		switch (ts.peek(++distance).type) {
+		case Token::LBRACE: ++depth; break;
+		case Token::RBRACE: --depth; break;
+		case Token::END_OF_FILE: return false;
+		default: break;
+		}
+	}
+
+	if (ts.peek(distance + 1).type != Token::SEMICOLON)
+		return false;
+
+	begin = ts.index();
+	end = begin + distance + 1;
+
+	while (ts.index() < end)
+		ts.next();
+
+	return true;
 }
 
 DeclPtr Parser::parseVariableDecl() {
@@ -194,8 +352,8 @@ DeclPtr Parser::parseVariableDecl() {
 
 		ExprPtr initializer = parseExpr();
 
-		return DeclPtr(new VariableDecl(location, identifier, type,
-		                                initializer));
+		return arena->make<VariableDecl>(location, identifier, type,
+		                                 initializer);
 	}
 }
 
@@ -213,7 +371,7 @@ ExprPtr Parser::parseBlockExpr() {
 
 	assumeNext(Token::RBRACE);
 
-	return ExprPtr(new BlockExpr(location, exprs));
+	return arena->make<BlockExpr>(location, std::move(exprs));
 }
 
 ExprPtr Parser::parseIfElseExpr() {
@@ -230,113 +388,51 @@ ExprPtr Parser::parseIfElseExpr() {
 	assumeNext(Token::KEYWORD_ELSE);
 	ExprPtr elseBody = parseExpr();
 
-	return ExprPtr(new IfElseExpr(location, condition, ifBody, elseBody));
-}
-
-ExprPtr Parser::parseAssignExpr() {
-	Location location = ts.get().location;
-
-	ExprPtr expr = parseEqualsExpr();
-	
-	// TODO
-
-	return expr;
-}
-
-ExprPtr Parser::parseEqualsExpr() {
-	Location location = ts.get().location;
-
-	ExprPtr expr = parseAddExpr();
-	
-	while (ts.get().type == Token::EQUALS) {
-		ts.next();
-
-		expr = ExprPtr(new BinaryExpr(location, BinaryExpr::EQUALS, expr,
-		                              parseAddExpr()));
-	}
-
-	return expr;
+	return arena->make<IfElseExpr>(location, condition, ifBody, elseBody);
 }
 
-ExprPtr Parser::parseAddExpr() {
-	Location location = ts.get().location;
-
-	ExprPtr expr = parseMulExpr();
-	
-	while (ts.get().type == Token::PLUS || ts.get().type == Token::MINUS) {
-		BinaryExpr::Operation operation;
-
-		switch (ts.get().type) {
-		case Token::PLUS:
-			operation = BinaryExpr::ADD;
-			break;
-		case Token::MINUS:
-			operation = BinaryExpr::SUB;
-			break;
-		default:
-			assert(false);
-		}
-
-		ts.next();
-
-		expr = ExprPtr(new BinaryExpr(location, operation, expr,
-		                              parseMulExpr()));
-		//location = ts.get().location;
-	}
-
-	return expr;
-}
-
-ExprPtr Parser::parseMulExpr() {
-	Location location = ts.get().location;
+// Parses operands and operators of at least minPrecedence. Operators of
+// the same precedence are folded in the loop, so only a higher one recurses
+// and the depth is bounded by the number of precedence levels.
+ExprPtr Parser::parseBinaryExpr(int minPrecedence) {
+	const Location location = ts.get().location;
 
 	ExprPtr expr = parsePrimaryExpr();
-	
-	while (ts.get().type == Token::STAR || ts.get().type == Token::SLASH) {
-		BinaryExpr::Operation operation;
-
-		switch (ts.get().type) {
-		case Token::STAR:
-			operation = BinaryExpr::MUL;
-			break;
-		case Token::SLASH:
-			operation = BinaryExpr::DIV;
-			break;
-		default:
-			assert(false);
-		}
+
+	for (;;) {
+		const BinaryOperator& op = binaryOperators[ts.get().type];
+		if (op.precedence < minPrecedence)
+			return expr;
 
 		ts.next();
 
-		expr = ExprPtr(new BinaryExpr(location, operation, expr,
-		                              parsePrimaryExpr()));
-		//location = ts.get().location;
+		// All operators are left-associative
+		ExprPtr right = parseBinaryExpr(op.precedence + 1);
+		expr = arena->make<BinaryExpr>(location, op.operation, expr, right);
 	}
-
-	return expr;
 }
 
 ExprPtr Parser::parsePrimaryExpr() {
 	const Location location = ts.get().location;
 
-	ExprPtr expr;
+	ExprPtr expr = 0;
 	
 	switch (ts.get().type) {
 	case Token::IDENTIFIER:
-		expr = ExprPtr(new IdentifierExpr(location, parseIdentifier()));
+		expr = arena->make<IdentifierExpr>(location, parseIdentifier());
 		break;
 
 	case Token::NUMBER: {
-		const int_t number = ts.get().number;
+		const int_t number = ts.get().number();
 		ts.next();
-		expr = ExprPtr(new LiteralNumberExpr(location, number));
+		expr = arena->make<LiteralNumberExpr>(location, number);
 		break;
 	}
 
 	case Token::STRING: {
-		const std::string string = ts.get().identifier;
+		const StringLiteral literal = ts.stringValue(ts.get());
 		ts.next();
-		expr = ExprPtr(new LiteralStringExpr(location, string));
+		expr = arena->make<LiteralStringExpr>(location, literal);
 		break;
 	}
 
@@ -344,14 +440,14 @@ ExprPtr Parser::parsePrimaryExpr() {
 	case Token::KEYWORD_FALSE: {
 		const Token::Type type = ts.get().type;
 		ts.next();
-		expr = ExprPtr(
-			new LiteralBoolExpr(location, type == Token::KEYWORD_TRUE));
+		expr = arena->make<LiteralBoolExpr>(location,
+		                                    type == Token::KEYWORD_TRUE);
 		break;
 	}
 
 	case Token::KEYWORD_VOID:
 		ts.next(); 
-		expr = ExprPtr(new VoidExpr(location));
+		expr = arena->make<VoidExpr>(location);
 		break;
 
 	case Token::LPAREN:
@@ -400,7 +496,8 @@ ExprPtr Parser::parsePostExpr(ExprPtr expr) {
 
 		assumeNext(Token::RPAREN);
 
-		return parsePostExpr(ExprPtr(new CallExpr(location, expr, arguments)));
+		return parsePostExpr(
+			arena->make<CallExpr>(location, expr, std::move(arguments)));
 	}
 
 	case Token::LBRACKET: {
@@ -409,8 +506,8 @@ ExprPtr Parser::parsePostExpr(ExprPtr expr) {
 		ExprPtr index = parseExpr();
 		assumeNext(Token::RBRACKET);
 
-		return parsePostExpr(ExprPtr(
-			new ArrayElementExpr(location, expr, index)));
+		return parsePostExpr(
+			arena->make<ArrayElementExpr>(location, expr, index));
 	}
 
 	default:
@@ -420,7 +517,7 @@ ExprPtr Parser::parsePostExpr(ExprPtr expr) {
 
 identifier_t Parser::parseIdentifier() {
 	assume(Token::IDENTIFIER);
-	const identifier_t identifier = ts.get().identifier;
+	const identifier_t identifier = ts.get().identifier();
 	ts.next();
 
 	return identifier;
@@ -451,8 +548,8 @@ void Parser::parseFunctionPrototype(TypePtr& returnType, identifier_t& name,
 				name = parseIdentifier();
 			}
 
-			parameters.push_back(ParameterDeclPtr(
-				new ParameterDecl(location, name, hasName, type)));	
+			parameters.push_back(
+				arena->make<ParameterDecl>(location, name, hasName, type));
 
 			if (ts.get().type != Token::COMMA)
 				doLoop = false;
@@ -3,47 +3,63 @@
 
 #include "common/context.hpp"
 #include "lexer/token_stream.hpp"
+#include "ast/decl.hpp"
 
 namespace llang {
-
-namespace ast {
-
-class Type;
-class Decl;
-class Module;
-class Expr;
-
-} // namespace ast
-
 namespace parser {
 
+class SkippedBodies;
+
 class Parser {
 public:
 	Parser(Context& context,
 	       const std::string& moduleName,
 	       lexer::TokenStream& ts)
-		: diag(context.diag), moduleName(moduleName), ts(ts) {
+		: context(context), diag(context.diag),
+		  identifiers(context.identifiers), moduleName(moduleName), ts(ts),
+		  arena(0), bodies(0) {
+	}
+
+	// Reports errors to diag instead of the context's
+	Parser(Context& context,
+	       Diagnostics& diag,
+	       const std::string& moduleName,
+	       lexer::TokenStream& ts)
+		: context(context), diag(diag), identifiers(context.identifiers),
+		  moduleName(moduleName), ts(ts), arena(0), bodies(0) {
 	}
 
+	// The caller owns the module, which owns all nodes (see ast::Arena).
+	// With Config::lazyFunctionBodies the module also keeps the tokens, to
+	// parse skipped bodies from, and the stream must not be STREAMING.
 	ast::ModulePtr parseModule();
 
+	// Parses a declaration at module level, including its ';'. Its nodes
+	// are allocated in arena (usually the module's), but it isn't added to
+	// the module.
+	ast::DeclPtr parseTopLevelDecl(ast::Arena& arena);
+
+	// Parses a function body that makes up the whole token stream
+	ast::ExprPtr parseBody(ast::Arena& arena);
+
+	// Returns a new empty module, owned by the caller
+	ast::ModulePtr makeModule(const Location& location);
+
 private:
 	ast::TypePtr parseType();
-	ast::DeclPtr parseDecl();
+	ast::DeclPtr parseDecl(bool topLevel = false);
 	ast::ExprPtr parseExpr();
 
 	ast::TypePtr parseFunctionType();
 
-	ast::DeclPtr parseFunctionDecl();
+	ast::DeclPtr parseFunctionDecl(bool topLevel = false);
+	bool skipBody(size_t& begin, size_t& end);
 	ast::DeclPtr parseVariableDecl();
 
 	ast::ExprPtr parseBlockExpr();
 	ast::ExprPtr parseIfElseExpr();
 
-	ast::ExprPtr parseAssignExpr();
-	ast::ExprPtr parseEqualsExpr();
-	ast::ExprPtr parseAddExpr();
-	ast::ExprPtr parseMulExpr();
+	ast::ExprPtr parseBinaryExpr(int minPrecedence);
 	ast::ExprPtr parsePrimaryExpr();
 	ast::ExprPtr parsePostExpr(ast::ExprPtr expr);
 
@@ -64,10 +80,15 @@ private:
 	void error(const char* format, ...);
 	void expectedError(const char* expected);
 
+	Context& context;
 	Diagnostics& diag;
+	Interner& identifiers;
 
 	const std::string& moduleName;
 	lexer::TokenStream& ts;
+
+	ast::Arena* arena; // where new nodes go
+	SkippedBodies* bodies; // null if bodies aren't skipped
 };
 
 } // namespace parser
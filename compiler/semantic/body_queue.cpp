@@ -0,0 +1,46 @@
+#include "common/trace.hpp"
+#include "ast/type.hpp"
+#include "ast/decl.hpp"
+#include "ast/expr.hpp"
+#include "semantic/phase1/visitors.hpp"
+#include "semantic/phase2/visitors.hpp"
+#include "semantic/body_queue.hpp"
+
+namespace llang {
+namespace semantic {
+
+using namespace ast;
+
+void BodyQueue::add(FunctionDeclPtr function) {
+	if (function->isBodySkipped() && added.insert(function).second)
+		queue.push_back(function);
+}
+
+void BodyQueue::run(Module& module) {
+	const identifier_t mainName = context.identifiers.intern("main");
+	if (FunctionDeclPtr main = isA<FunctionDecl>(module.scope->lookup(mainName)))
+		add(main);
+
+	ScopeState state;
+	state.arena = &module.arena;
+	state.types = &module.types;
+	state.bodies = this;
+	state.symbols = &symbols;
+
+	// Grows while it's being worked through
+	for (size_t i = 0; i < queue.size(); ++i) {
+		FunctionDeclPtr function = queue[i];
+
+		LLANG_TRACE(SEMA, "loading body of '%s'",
+		            context.identifiers.c_str(function->name));
+
+		function->loadBody();
+		analyzePhase1Body(context, phase1, function, state);
+		analyzePhase2Body(context, phase2, function, state);
+	}
+
+	queue.clear();
+}
+
+} // namespace semantic
+} // namespace llang
@@ -0,0 +1,57 @@
+#ifndef LLANG_SEMANTIC_BODY_QUEUE_HPP_INCLUDED
+#define LLANG_SEMANTIC_BODY_QUEUE_HPP_INCLUDED
+
+#include <set>
+#include <vector>
+
+#include "common/context.hpp"
+#include "semantic/symbol_table.hpp"
+#include "semantic/visitor.hpp"
+
+namespace llang {
+
+namespace ast {
+
+class Module;
+class FunctionDecl;
+
+} // namespace ast
+
+namespace semantic {
+
+// Analyzes the function bodies the parser skipped (see
+// Config::lazyFunctionBodies) once they turn out to be used.
+//
+// Both phases run on the module as usual, leaving skipped bodies alone, and
+// phase 1 adds every function it finds a reference to. run then parses and
+// analyzes main and the added bodies, which can add more, until there are
+// none left. Functions that are never used keep their bodies unparsed and
+// are left out by codegen.
+class BodyQueue {
+public:
+	BodyQueue(Context& context, Visitors& phase1, Visitors& phase2)
+		: context(context), phase1(phase1), phase2(phase2) {
+	}
+
+	// Does nothing if the body wasn't skipped or the function was added
+	// before
+	void add(ast::FunctionDecl* function);
+
+	void run(ast::Module& module);
+
+private:
+	Context& context;
+	Visitors& phase1;
+	Visitors& phase2;
+
+	std::vector<ast::FunctionDecl*> queue;
+	std::set<ast::FunctionDecl*> added;
+
+	// Kept for all bodies, which mostly look up the module's names
+	SymbolTable symbols;
+};
+
+} // namespace semantic
+} // namespace llang
+
+#endif
@@ -1,9 +1,14 @@
 #include <cassert>
 #include <iostream>
 
+#include "common/trace.hpp"
+#include "common/trace_events.hpp"
 #include "ast/type.hpp"
 #include "ast/decl.hpp"
 #include "ast/expr.hpp"
+#include "ast/node_count.hpp"
+#include "semantic/body_queue.hpp"
+#include "semantic/symbol_table.hpp"
 #include "semantic/phase1/visitors.hpp"
 
 namespace llang {
@@ -13,6 +18,84 @@ using namespace ast;
 
 namespace {
 
+void addDecl(Context& context, Scope* scope, DeclPtr decl) {
+	if (!scope->addDecl(decl)) {
+		context.diag.error(decl->location(), "symbol already declared: %s",
+			context.identifiers.c_str(decl->name));
+	}
+}
+
+// Adds the declarations of a scope to it before any of its names are
+// resolved, so they can be used before the place they're declared at.
+// Blocks and function bodies have scopes of their own and are left for
+// later.
+class DeclCollector : public ast::Visitor<void, void> {
+public:
+	DeclCollector(Context& context, Scope* scope, FunctionDeclPtr function)
+		: context(context), scope(scope), function(function) {
+	}
+
+	void collect(NodePtr node) {
+		if (node) accept(node);
+	}
+
+	template <typename T> void collect(T begin, T end) {
+		for (; begin != end; ++begin)
+			collect(*begin);
+	}
+
+protected:
+	virtual void visit(VariableDeclPtr variable) {
+		collect(variable->initializer);
+
+		variable->declScope = scope;
+		variable->function = function;
+		addDecl(context, scope, variable);
+	}
+
+	virtual void visit(FunctionDeclPtr function) {
+		function->declScope = scope;
+		addDecl(context, scope, function);
+	}
+
+	virtual void visit(BinaryExprPtr expr) {
+		collect(expr->left);
+		collect(expr->right);
+	}
+
+	virtual void visit(LiteralNumberExprPtr) {}
+	virtual void visit(LiteralStringExprPtr) {}
+	virtual void visit(LiteralBoolExprPtr) {}
+	virtual void visit(VoidExprPtr) {}
+	virtual void visit(IdentifierExprPtr) {}
+	virtual void visit(BlockExprPtr) {}
+
+	virtual void visit(IfElseExprPtr expr) {
+		collect(expr->condition);
+		collect(expr->ifExpr);
+		collect(expr->elseExpr);
+	}
+
+	virtual void visit(CallExprPtr call) {
+		collect(call->callee);
+		collect(call->arguments.begin(), call->arguments.end());
+	}
+
+	virtual void visit(DeclExprPtr expr) {
+		collect(expr->decl);
+	}
+
+	virtual void visit(ArrayElementExprPtr expr) {
+		collect(expr->array);
+		collect(expr->index);
+	}
+
+private:
+	Context& context;
+	Scope* scope;
+	FunctionDeclPtr function; // null outside of functions
+};
+
 class TypeVisitor : public VisitorBase<TypePtr> {
 private:
 	TypeVisitor(Context& context)
@@ -20,26 +103,27 @@ private:
 	friend Visitors* semantic::makePhase1Visitors(Context&);
 
 protected:
+	// Types are replaced with the module's unique ones
+
 	virtual TypePtr visit(ArrayTypePtr type, ScopeState state) {
 		acceptOn(type->inner, state);
-		return type;
+		return state.types->array(type->inner);
 	}
 
 	virtual TypePtr visit(FunctionTypePtr type, ScopeState state) {
 		acceptOn(type->returnType, state);
 		acceptOn(type->parameterTypes.begin(), type->parameterTypes.end(),
 		         state);
-		return type;
+		return state.types->function(type->returnType,
+		                             std::move(type->parameterTypes));
 	}
 
-	virtual TypePtr visit(IntegralTypePtr type, ScopeState) {
-		if (type->type == IntegralType::STRING) {
-			TypePtr inner(new IntegralType(type->location(),
-			                               IntegralType::CHAR));
-			return TypePtr(new ArrayType(type->location(), inner));
-		}
+	virtual TypePtr visit(IntegralTypePtr type, ScopeState state) {
+		if (type->type == IntegralType::STRING)
+			return state.types->array(
+				state.types->integral(IntegralType::CHAR));
 		
-		return type;
+		return state.types->integral(type->type);
 	}
 };
 
@@ -53,11 +137,15 @@ protected:
 	virtual DeclPtr visit(ModulePtr module, ScopeState state) {
 		module->scope = ScopePtr(new Scope(0));
 		state.scope = module->scope.get();
+		state.arena = &module->arena;
+		state.types = &module->types;
 
-		for (auto it = module->decls.begin(); it != module->decls.end(); ++it) {
-			acceptOn(*it, state);
-			module->scope->addDecl(*it);
-		}
+		SymbolTable symbols;
+		state.symbols = &symbols;
+
+		DeclCollector(context, state.scope, 0).collect(module->decls.begin(),
+		                                               module->decls.end());
+		acceptOn(module->decls.begin(), module->decls.end(), state);
 
 		return module;
 	}
@@ -65,8 +153,6 @@ protected:
 	virtual DeclPtr visit(VariableDeclPtr variable, ScopeState state) {
 		acceptOn(variable->type, state);
 		acceptOn(variable->initializer, state);
-		variable->declScope = state.scope;
-		variable->function = state.function;
 		return variable;
 	}
 
@@ -77,13 +163,20 @@ protected:
 	}
 
 	virtual DeclPtr visit(FunctionDeclPtr function, ScopeState state) {
+		trace::Span span("phase1", context.identifiers.c_str(function->name));
+		annotateSpan(span, context.sources, function);
+
 		function->scope = ScopePtr(new Scope(state.scope));
-		function->declScope = state.scope;
+
+		function->parentFunction = state.function;
+		function->isNested = state.function != 0;
+		state.inNestedFunction = state.function != 0;
 
 		state.scope = function->scope.get();
 		state.function = function;
 
 		FunctionType::ParameterTypeList parameterTypes;
+		parameterTypes.reserve(function->parameters.size());
 
 		for (auto it = function->parameters.begin();
 		     it != function->parameters.end();
@@ -91,17 +184,21 @@ protected:
 			*it = assumeIsA<ParameterDecl>(accept(*it, state));
 
 			if((*it)->hasName)
-				state.scope->addDecl(*it);
+				addDecl(context, state.scope, *it);
 
 			parameterTypes.push_back((*it)->type);
 		}
 
 		acceptOn(function->returnType, state);
-		if (function->body) acceptOn(function->body, state);
 
-		function->type = TypePtr(new FunctionType(function->location(),
-		                                          function->returnType,
-		                                          parameterTypes));
+		if (function->body) {
+			DeclCollector(context, state.scope, function).collect(
+				function->body);
+			acceptOn(function->body, state);
+		}
+
+		function->type = state.types->function(function->returnType,
+		                                       std::move(parameterTypes));
 
 		return function;
 	}
@@ -113,6 +210,20 @@ private:
 		: VisitorBase<ExprPtr>(context) {}
 	friend Visitors* semantic::makePhase1Visitors(Context&);
 
+	void trackOuterVariables(VariableDeclPtr variable, ScopeState state) {
+		if (state.inNestedFunction) {
+			// Check if this variable was declared in an outer function
+			if (variable->function && variable->function != state.function) {
+				// Add to the current function's list of used outer variables
+				state.function->outerVariables.push_back(variable);
+
+				LLANG_TRACE(CLOSURE, "function '%s' uses outer variable '%s'",
+				            context.identifiers.c_str(state.function->name),
+				            context.identifiers.c_str(variable->name));
+			}
+		}
+	}
+
 protected:
 	virtual ExprPtr visit(BinaryExprPtr expr, ScopeState state) {
 		acceptOn(expr->left, state);
@@ -122,16 +233,28 @@ protected:
 	}
 
 	virtual ExprPtr visit(IdentifierExprPtr identifier, ScopeState state) {
-		// Delay looking up the decl to the next semantic phase
+		// Every decl of the scopes around is known by now. The type is set
+		// in the next semantic phase, function types may still be missing.
+		DeclPtr decl = state.symbols->lookup(state.scope, identifier->name);
+
+		if (!decl) {
+			context.diag.error(identifier->location(),
+				"symbol not found: %s",
+				context.identifiers.c_str(identifier->name));
+		}
 
-		DeclPtr decl(
-			new DelayedDecl(identifier->location(), identifier->name));
-		decl->declScope = state.scope;
+		if (FunctionDeclPtr function = isA<FunctionDecl>(decl)) {
+			if (function->isBodySkipped()) {
+				assert(state.bodies);
+				state.bodies->add(function);
+			}
+		}
+		else if (VariableDeclPtr variable = isA<VariableDecl>(decl)) {
+			trackOuterVariables(variable, state);
+		}
 
-		ExprPtr expr(
-			new DelayedExpr(identifier->location(), decl));
-     
-		return expr;
+		return state.arena->make<DeclRefExpr>(identifier->location(),
+		                                      TypePtr(), decl);
 	}
 
 	virtual ExprPtr visit(CallExprPtr call, ScopeState state) {
@@ -143,6 +266,8 @@ protected:
 
 	virtual ExprPtr visit(BlockExprPtr block, ScopeState state) {
 		block->scope = ScopePtr(new Scope(state.scope));
+		DeclCollector(context, block->scope.get(), state.function).collect(
+			block->exprs.begin(), block->exprs.end());
 
 		acceptOn(block->exprs.begin(), block->exprs.end(),
 		         state.withScope(block->scope.get()));
@@ -150,53 +275,39 @@ protected:
 		return block;
 	}
 
-	virtual ExprPtr visit(LiteralNumberExprPtr literal, ScopeState) {
+	virtual ExprPtr visit(LiteralNumberExprPtr literal, ScopeState state) {
 		//TypePtr type(new NumberType(literal->location()));
 
 		// TODO: hardcoded type
-		TypePtr type(new IntegralType(literal->location(),
-		                              IntegralType::I32));
-
-		literal->type = type;
+		literal->type = state.types->integral(IntegralType::I32);
 
 		return literal;
 	}
 
-	virtual ExprPtr visit(LiteralStringExprPtr literal, ScopeState) {
-		TypePtr type(new ArrayType(literal->location(),
-			TypePtr(new IntegralType(literal->location(),
-			                         IntegralType::CHAR))));
-		
-		literal->type = type;
+	virtual ExprPtr visit(LiteralStringExprPtr literal, ScopeState state) {
+		literal->type = state.types->array(
+			state.types->integral(IntegralType::CHAR));
 
 		return literal;
 	}
 
-	virtual ExprPtr visit(LiteralBoolExprPtr literal, ScopeState) {
-		TypePtr type(new IntegralType(literal->location(), IntegralType::BOOL));
-
-		literal->type = type;
+	virtual ExprPtr visit(LiteralBoolExprPtr literal, ScopeState state) {
+		literal->type = state.types->integral(IntegralType::BOOL);
 
 		return literal;
 	}
 
-	virtual ExprPtr visit(VoidExprPtr voidExpr, ScopeState) {
-		TypePtr type(new IntegralType(voidExpr->location(),
-		                              IntegralType::VOID));
-		
-		voidExpr->type = type;
+	virtual ExprPtr visit(VoidExprPtr voidExpr, ScopeState state) {
+		voidExpr->type = state.types->integral(IntegralType::VOID);
 
 		return voidExpr;
 	}
 
 	virtual ExprPtr visit(DeclExprPtr declExpr, ScopeState state) {
-		DeclPtr decl = accept(declExpr->decl, state); 
-
-		state.scope->addDecl(decl);
-		declExpr->decl = decl;
+		// Added to the scope by the DeclCollector
+		acceptOn(declExpr->decl, state);
 
-		TypePtr type(new IntegralType(declExpr->location(), IntegralType::VOID));
-		declExpr->type = type;
+		declExpr->type = state.types->integral(IntegralType::VOID);
 
 		return declExpr;
 	}	
@@ -233,5 +344,19 @@ Visitors* makePhase1Visitors(Context& context) {
 	return visitors;
 }
 
+void analyzePhase1Body(Context& context, Visitors& visitors,
+                       FunctionDeclPtr function, ScopeState state) {
+	trace::Span span("phase1", context.identifiers.c_str(function->name));
+	annotateSpan(span, context.sources, function);
+
+	state.scope = function->scope.get();
+	state.function = function;
+	state.inNestedFunction = false;
+
+	DeclCollector(context, state.scope, function).collect(
+		function->body);
+	function->body = visitors.exprVisitor->accept(function->body, state);
+}
+
 } // namespace semantic
 } // namespace llang
@@ -9,6 +9,11 @@ namespace semantic {
 
 Visitors* makePhase1Visitors(Context&);
 
+// Runs phase 1 on the body of a top-level function that was loaded after
+// the module was analyzed (see BodyQueue)
+void analyzePhase1Body(Context& context, Visitors& visitors,
+                       ast::FunctionDecl* function, ScopeState state);
+
 } // namespace semantic
 } // namespace llang
 
@@ -1,9 +1,10 @@
 #include <cassert>
 #include <cstdio>
-#include <iostream>
 
+#include "common/trace_events.hpp"
 #include "ast/decl.hpp"
 #include "ast/expr.hpp"
+#include "ast/node_count.hpp"
 #include "ast/type.hpp"
 #include "ast/type_test.hpp"
 #include "semantic/phase2/visitors.hpp"
@@ -15,17 +16,31 @@ using namespace ast;
 
 namespace {
 
-bool allowImplicitCast(ExprPtr& expr, TypePtr to) {
+bool allowImplicitCast(ExprPtr& expr, TypePtr to, Arena& arena) {
 	if (expr->type->equals(to)) return false;
 
 	if (expr->type->canCastImplicitly(to)) {
-		expr = ExprPtr(new ImplicitCastExpr(expr->location(), to, expr));
+		expr = arena.make<ImplicitCastExpr>(expr->location(), to, expr);
 		return true;
 	}
 	
 	return false;
 }
 
+// Checks an analyzed body against the function's return type
+void checkBody(Context& context, FunctionDeclPtr function, Arena& arena) {
+	allowImplicitCast(function->body, function->returnType, arena);
+
+	// TODO: implicit cast to void
+	if (!function->body->type->equals(function->returnType)) {
+		context.diag.error(function->body->location(),
+			"wrong type in function body expr of '%s': "
+			"expected '%s', got '%s'",
+			context.identifiers.c_str(function->name),
+			function->returnType->name().c_str(),
+			function->body->type->name().c_str());
+	}
+}
 
 class TypeVisitor : public VisitorBase<TypePtr> {
 private:
@@ -64,6 +79,8 @@ private:
 
 protected:
 	virtual DeclPtr visit(ModulePtr module, ScopeState state) {
+		state.arena = &module->arena;
+		state.types = &module->types;
 		acceptScope(module->scope.get(), state);
 		return module;
 	}
@@ -75,15 +92,15 @@ protected:
 		if (isVoid(variable->type))
 			context.diag.error(variable->location(),
 				"cannot declare variable '%s' of type void",
-				variable->name.c_str());
+				context.identifiers.c_str(variable->name));
 
-		allowImplicitCast(variable->initializer, variable->type);
+		allowImplicitCast(variable->initializer, variable->type, *state.arena);
 
 		if (!variable->type->equals(variable->initializer->type)) {
 			context.diag.error(variable->location(),
 				"initializer of %s has wrong type: "
 				"expected '%s', got '%s'",
-				variable->name.c_str(),
+				context.identifiers.c_str(variable->name),
 				variable->type->name().c_str(),
 				variable->initializer->type->name().c_str());
 		}
@@ -102,6 +119,9 @@ protected:
 	}
 
 	virtual DeclPtr visit(FunctionDeclPtr function, ScopeState state) {
+		trace::Span span("phase2", context.identifiers.c_str(function->name));
+		annotateSpan(span, context.sources, function);
+
 		for (auto it = function->parameters.begin();
 		     it != function->parameters.end();
 		     ++it) {
@@ -112,42 +132,13 @@ protected:
 
 		acceptOn(function->returnType, state);
 
-		function->isNested = function->parentFunction = state.function;
-		state.inNestedFunction = state.function;
-
-		state.function = function;
-		state.scope = function->scope.get();
-
 		if (function->body) {
 			acceptOn(function->body, state);
-
-			allowImplicitCast(function->body, function->returnType);
-
-			// TODO: implicit cast to void
-			if (!function->body->type->equals(function->returnType)) {
-				context.diag.error(function->body->location(),
-					"wrong type in function body expr of '%s': "
-					"expected '%s', got '%s'",
-					function->name.c_str(),
-					function->returnType->name().c_str(),
-					function->body->type->name().c_str());
-			}
+			checkBody(context, function, *state.arena);
 		}
 
 		return function;
 	}
-
-	virtual DeclPtr visit(DelayedDeclPtr delayed, ScopeState state) {
-		DeclPtr decl = state.scope->lookup(delayed->name);
-		
-		if (!decl) {
-			context.diag.error(delayed->location(),
-				"symbol not found: %s",
-				delayed->name.c_str());
-		}
-
-		return decl;
-	}
 };
 
 class ExprVisitor : public VisitorBase<ExprPtr> {
@@ -156,20 +147,6 @@ private:
 		: VisitorBase<ExprPtr>(context) {}
 	friend Visitors* semantic::makePhase2Visitors(Context&);
 
-	void trackOuterVariables(VariableDeclPtr variable, ScopeState state) {
-		if (state.inNestedFunction) {
-			// Check if this variable was declared in an outer function
-			if (variable->function && variable->function != state.function) {
-				// Add to the current function's list of used outer variables
-				state.function->outerVariables.push_back(variable);
-
-				std::cout << "function '" << state.function->name << "'"
-				          << " uses outer variable '" << variable->name << "'"
-				          << std::endl;
-			}
-		}
-	}
-
 protected:
 #define ID_VISIT(type) \
 	virtual ExprPtr visit(type##Ptr ptr, ScopeState) \
@@ -187,39 +164,24 @@ protected:
 		return decl;
 	}
 
-	virtual ExprPtr visit(DelayedExprPtr delayed, ScopeState state) {
-		DeclPtr decl = accept(delayed->delayedDecl, state);
-		
-		TypePtr type;
-		if (FunctionDeclPtr function = isA<FunctionDecl>(decl)) {
-			type = function->type;
-		}
-		else if (ParameterDeclPtr parameter = isA<ParameterDecl>(decl)) {
-			type = parameter->type;
+	virtual ExprPtr visit(DeclRefExprPtr ref, ScopeState) {
+		// Phase 1 resolved the name, but not every type was known then
+		if (FunctionDeclPtr function = isA<FunctionDecl>(ref->decl))
+			ref->type = function->type;
+		else if (VariableDeclPtr variable = isA<VariableDecl>(ref->decl))
+			ref->type = variable->type;
 
-			trackOuterVariables(parameter, state);
-		}
-		else if (VariableDeclPtr variable = isA<VariableDecl>(decl)) {
-			type = variable->type;
+		assert(ref->type);
 
-			trackOuterVariables(variable, state);
-		}
-
-		assert(type);
-
-		return ExprPtr(new DeclRefExpr(delayed->location(), type, decl));
-	}	
+		return ref;
+	}
 
 	virtual ExprPtr visit(BlockExprPtr block, ScopeState state) {
-		//acceptScope(block->scope.get(), state);
-		state.scope = block->scope.get();
-
 		acceptOn(block->exprs.begin(), block->exprs.end(), state);
 
 		block->type = block->exprs.size() ?
 			block->exprs.back()->type :
-			TypePtr(new IntegralType(block->location(),
-			                         ast::IntegralType::VOID));
+			state.types->integral(ast::IntegralType::VOID);
 
 		return block;
 	}
@@ -250,7 +212,7 @@ protected:
 			for (; it1 != call->arguments.end(); ++it1, ++it2, ++i) {
 				ExprPtr& argument = *it1 = accept(*it1, state); 
 
-				allowImplicitCast(*it1, *it2);
+				allowImplicitCast(*it1, *it2, *state.arena);
 
 				if (!argument->type->equals(*it2)) {
 					std::string expectedType = (*it2)->name();
@@ -272,8 +234,8 @@ protected:
 		acceptOn(binary->left, state);
 		acceptOn(binary->right, state);
 
-		if (!allowImplicitCast(binary->left, binary->right->type))
-			allowImplicitCast(binary->right, binary->left->type);
+		if (!allowImplicitCast(binary->left, binary->right->type, *state.arena))
+			allowImplicitCast(binary->right, binary->left->type, *state.arena);
 
 		if (!binary->left->type->equals(binary->right->type)) {
 			context.diag.error(binary->location(),
@@ -283,8 +245,7 @@ protected:
 		}
 
 		if (binary->operation == ast::BinaryExpr::EQUALS) {
-			binary->type = TypePtr(new IntegralType(binary->location(),
-			                                        ast::IntegralType::BOOL));	
+			binary->type = state.types->integral(ast::IntegralType::BOOL);
 		}
 		else
 			binary->type = binary->left->type;
@@ -302,8 +263,10 @@ protected:
 				"if condition needs to be boolean (got '%s')",
 				ifElse->condition->type->name().c_str());
 
-		if (!allowImplicitCast(ifElse->ifExpr, ifElse->elseExpr->type))
-			allowImplicitCast(ifElse->elseExpr, ifElse->ifExpr->type);
+		if (!allowImplicitCast(ifElse->ifExpr, ifElse->elseExpr->type,
+		                       *state.arena))
+			allowImplicitCast(ifElse->elseExpr, ifElse->ifExpr->type,
+			                  *state.arena);
 
 		// TODO: this is not optimal
 		if (!ifElse->ifExpr->type->equals(ifElse->elseExpr->type))
@@ -328,9 +291,8 @@ protected:
 				element->array->type->name().c_str());
 
 		// TODO: hardcoded type
-		TypePtr indexType(new IntegralType(element->location(),
-		                                   IntegralType::I32));
-		allowImplicitCast(element->index, indexType);
+		TypePtr indexType = state.types->integral(IntegralType::I32);
+		allowImplicitCast(element->index, indexType, *state.arena);
 
 		if (!element->index->type->equals(indexType))
 			context.diag.error(element->location(),
@@ -359,6 +321,15 @@ Visitors* makePhase2Visitors(Context& context) {
 	return visitors;
 }
 
+void analyzePhase2Body(Context& context, Visitors& visitors,
+                       FunctionDeclPtr function, ScopeState state) {
+	trace::Span span("phase2", context.identifiers.c_str(function->name));
+	annotateSpan(span, context.sources, function);
+
+	function->body = visitors.exprVisitor->accept(function->body, state);
+	checkBody(context, function, *state.arena);
+}
+
 } // namespace semantic
 } // namespace llang
 
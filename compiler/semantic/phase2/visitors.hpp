@@ -11,6 +11,11 @@ namespace semantic {
 
 Visitors* makePhase2Visitors(Context&);
 
+// Runs phase 2 on the body of a top-level function after phase 1 (see
+// BodyQueue)
+void analyzePhase2Body(Context& context, Visitors& visitors,
+                       ast::FunctionDecl* function, ScopeState state);
+
 } // namespace semantic
 } // namespace llang
 
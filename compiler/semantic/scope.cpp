@@ -1,4 +1,4 @@
-#include <stdexcept>
+#include <cassert>
 
 #include "ast/decl.hpp"
 #include "semantic/scope.hpp"
@@ -8,17 +8,14 @@ namespace semantic {
 
 using namespace ast;
 
-void Scope::addDecl(DeclPtr decl) {
+bool Scope::addDecl(DeclPtr decl) {
 	assert(decl);
-	assert(decl->name != "");
+	assert(!decl->name.empty());
 
-	if (decls.find(decl->name) != decls.end())
-		throw std::runtime_error("symbol already declared: " + decl->name);
-
-	decls.insert(DeclMap::value_type(decl->name, decl));
+	return decls.insert(DeclMap::value_type(decl->name, decl)).second;
 }
 
-DeclPtr Scope::lookup(const identifier_t& name) {
+DeclPtr Scope::lookup(identifier_t name) {
 	DeclMap::iterator it = decls.find(name);
 	
 	if (it == decls.end()) {
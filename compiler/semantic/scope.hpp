@@ -14,8 +14,9 @@ class Scope {
 public:
 	Scope(Scope* parent = 0) : parent_(parent) {}
 
-	void addDecl(ast::DeclPtr decl);
-	ast::DeclPtr lookup(const identifier_t& name);
+	// Returns false if the name is already declared in this scope
+	bool addDecl(ast::DeclPtr decl);
+	ast::DeclPtr lookup(identifier_t name);
 
 	Scope* parent() { return parent_; }
 	const Scope* parent() const { return parent_; }
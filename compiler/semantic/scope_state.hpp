@@ -5,18 +5,42 @@
 #include "semantic/scope.hpp"
 
 namespace llang {
+
+namespace ast {
+
+class Arena;
+class FunctionDecl;
+class TypeContext;
+
+} // namespace ast
+
 namespace semantic {
 
+class BodyQueue;
+class SymbolTable;
+
 struct ScopeState {
 	Scope* scope;
 	ast::TypePtr expectedType;
 	
 	// Null if we're not in a function
-	ast::FunctionDeclPtr function;
+	ast::FunctionDecl* function;
 	bool inNestedFunction;
 
+	// Arena and types of the module being analyzed, for new nodes
+	ast::Arena* arena;
+	ast::TypeContext* types;
+
+	// Gets the functions used whose bodies the parser skipped. Only needed
+	// with Config::lazyFunctionBodies.
+	BodyQueue* bodies;
+
+	// Resolves names in phase 1
+	SymbolTable* symbols;
+
 	ScopeState()
-		: scope(0), inNestedFunction(false) {
+		: scope(0), expectedType(0), function(0), inNestedFunction(false),
+		  arena(0), types(0), bodies(0), symbols(0) {
 	}
 
 	ScopeState withScope(Scope* scope) const {
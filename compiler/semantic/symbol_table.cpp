@@ -0,0 +1,66 @@
+#include "ast/decl.hpp"
+#include "semantic/symbol_table.hpp"
+
+namespace llang {
+namespace semantic {
+
+using namespace ast;
+
+DeclPtr SymbolTable::lookup(Scope* scope, identifier_t name) {
+	moveTo(scope);
+
+	if (name.id() >= innermost.size() || !innermost[name.id()])
+		return DeclPtr();
+
+	return bindings[innermost[name.id()] - 1].decl;
+}
+
+void SymbolTable::moveTo(Scope* scope) {
+	if (!entered.empty() && entered.back().scope == scope)
+		return;
+
+	// Innermost first
+	chain.clear();
+	for (Scope* s = scope; s; s = s->parent())
+		chain.push_back(s);
+
+	// Keep the outer scopes the two have in common
+	size_t common = 0;
+	while (common < entered.size() && common < chain.size() &&
+	       entered[common].scope == chain[chain.size() - 1 - common])
+		++common;
+
+	while (entered.size() > common)
+		leave();
+
+	for (size_t i = common; i < chain.size(); ++i)
+		enter(chain[chain.size() - 1 - i]);
+}
+
+void SymbolTable::enter(Scope* scope) {
+	Entered scopeEntry = { scope, bindings.size() };
+	entered.push_back(scopeEntry);
+
+	for (auto it = scope->decls.begin(); it != scope->decls.end(); ++it) {
+		const uint32_t name = it->first.id();
+		if (name >= innermost.size())
+			innermost.resize(name + 1, 0);
+
+		Binding binding = { name, it->second, innermost[name] };
+		bindings.push_back(binding);
+		innermost[name] = static_cast<uint32_t>(bindings.size());
+	}
+}
+
+void SymbolTable::leave() {
+	const size_t firstBinding = entered.back().firstBinding;
+	entered.pop_back();
+
+	while (bindings.size() > firstBinding) {
+		innermost[bindings.back().name] = bindings.back().hidden;
+		bindings.pop_back();
+	}
+}
+
+} // namespace semantic
+} // namespace llang
@@ -0,0 +1,65 @@
+#ifndef LLANG_SEMANTIC_SYMBOL_TABLE_HPP_INCLUDED
+#define LLANG_SEMANTIC_SYMBOL_TABLE_HPP_INCLUDED
+
+#include <stdint.h>
+#include <vector>
+
+#include "common/identifier.hpp"
+#include "ast/decl_ptr.hpp"
+#include "semantic/scope.hpp"
+
+namespace llang {
+namespace semantic {
+
+// Looks names up in a scope and its parents with one table for all of them,
+// instead of asking every scope on the way (Scope::lookup).
+//
+// The table holds the declarations of a chain of scopes, from the module's
+// down to the innermost one. Every name maps to its innermost binding,
+// which remembers the one it hides, and leaving a scope undoes its
+// bindings. Lookups follow the scope they're made from: the table leaves
+// the scopes that aren't parents of it and enters the ones that are
+// missing, which costs nothing when the scope stays the same.
+//
+// The Scope objects stay as they are; this only makes finding names in them
+// faster. A scope must not get new declarations while it is entered.
+class SymbolTable {
+public:
+	SymbolTable() {}
+
+	// The declaration the name refers to in scope, or null
+	ast::DeclPtr lookup(Scope* scope, identifier_t name);
+
+private:
+	SymbolTable(const SymbolTable&);
+	SymbolTable& operator=(const SymbolTable&);
+
+	void moveTo(Scope* scope);
+	void enter(Scope* scope);
+	void leave();
+
+	struct Binding {
+		uint32_t name;
+		ast::DeclPtr decl;
+		uint32_t hidden; // the binding this one hides, index + 1 or 0
+	};
+
+	struct Entered {
+		Scope* scope;
+		size_t firstBinding;
+	};
+
+	std::vector<Binding> bindings;
+	std::vector<Entered> entered; // outermost first
+
+	// Innermost binding of every name, index + 1 or 0. Identifiers are
+	// numbered densely by the interner, so they index it directly.
+	std::vector<uint32_t> innermost;
+
+	std::vector<Scope*> chain; // for moveTo
+};
+
+} // namespace semantic
+} // namespace llang
+
+#endif
@@ -51,7 +51,7 @@ protected:
 		return visitors->exprVisitor->accept(n, p);
 	}
 
-	template<typename T> void acceptOn(shared_ptr<T>& n, const ScopeState& p) {
+	template<typename T> void acceptOn(T*& n, const ScopeState& p) {
 		n = accept(n, p);
 	}
 
@@ -0,0 +1,232 @@
+#include <cassert>
+
+#include "util/scan.hpp"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define LLANG_SCAN_X86
+#include <immintrin.h>
+#endif
+
+namespace llang {
+namespace scan {
+
+#define W WHITESPACE
+#define L (IDENTIFIER_START | IDENTIFIER)
+#define D (IDENTIFIER | DIGIT)
+
+// Only ASCII has classes, the upper half is zero
+const unsigned char charClasses[256] = {
+	0, 0, 0, 0, 0, 0, 0, 0, 0, W, W, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	W, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	D, D, D, D, D, D, D, D, D, D, 0, 0, 0, 0, 0, 0,
+	0, L, L, L, L, L, L, L, L, L, L, L, L, L, L, L,
+	L, L, L, L, L, L, L, L, L, L, L, 0, 0, 0, 0, L,
+	0, L, L, L, L, L, L, L, L, L, L, L, L, L, L, L,
+	L, L, L, L, L, L, L, L, L, L, L, 0, 0, 0, 0, 0
+};
+
+#undef W
+#undef L
+#undef D
+
+namespace {
+
+// Scalar fallback
+
+size_t countNewlinesScalar(const char* begin, const char* end) {
+	size_t count = 0;
+	for (const char* c = begin; c != end; ++c)
+		count += *c == '\n';
+	return count;
+}
+
+void findNewlinesScalar(const char* begin, const char* end, uint32_t* out) {
+	for (const char* c = begin; c != end; ++c) {
+		if (*c == '\n')
+			*out++ = static_cast<uint32_t>(c - begin);
+	}
+}
+
+#ifdef LLANG_SCAN_X86
+
+// The SIMD kernels compare whole blocks against '\n' and walk the bits of
+// the resulting mask.
+
+#define SCAN_TARGET __attribute__((target("sse2")))
+
+SCAN_TARGET inline __m128i load16(const char* c) {
+	return _mm_loadu_si128(reinterpret_cast<const __m128i*>(c));
+}
+
+SCAN_TARGET inline unsigned mask16(__m128i m) {
+	return static_cast<unsigned>(_mm_movemask_epi8(m));
+}
+
+SCAN_TARGET size_t countNewlinesSse2(const char* begin, const char* end) {
+	size_t count = 0;
+	const char* c = begin;
+
+	for (; end - c >= 16; c += 16) {
+		count += static_cast<size_t>(__builtin_popcount(
+			mask16(_mm_cmpeq_epi8(load16(c), _mm_set1_epi8('\n')))));
+	}
+
+	return count + countNewlinesScalar(c, end);
+}
+
+SCAN_TARGET void findNewlinesSse2(const char* begin, const char* end,
+                                  uint32_t* out) {
+	const char* c = begin;
+
+	for (; end - c >= 16; c += 16) {
+		unsigned mask = mask16(_mm_cmpeq_epi8(load16(c), _mm_set1_epi8('\n')));
+		const uint32_t offset = static_cast<uint32_t>(c - begin);
+
+		for (; mask; mask &= mask - 1)
+			*out++ = offset + static_cast<uint32_t>(__builtin_ctz(mask));
+	}
+
+	for (; c != end; ++c) {
+		if (*c == '\n')
+			*out++ = static_cast<uint32_t>(c - begin);
+	}
+}
+
+#undef SCAN_TARGET
+#define SCAN_TARGET __attribute__((target("avx2")))
+
+SCAN_TARGET inline __m256i load32(const char* c) {
+	return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(c));
+}
+
+SCAN_TARGET inline uint32_t mask32(__m256i m) {
+	return static_cast<uint32_t>(_mm256_movemask_epi8(m));
+}
+
+SCAN_TARGET size_t countNewlinesAvx2(const char* begin, const char* end) {
+	size_t count = 0;
+	const char* c = begin;
+
+	for (; end - c >= 32; c += 32) {
+		count += static_cast<size_t>(__builtin_popcount(
+			mask32(_mm256_cmpeq_epi8(load32(c), _mm256_set1_epi8('\n')))));
+	}
+
+	return count + countNewlinesScalar(c, end);
+}
+
+SCAN_TARGET void findNewlinesAvx2(const char* begin, const char* end,
+                                  uint32_t* out) {
+	const char* c = begin;
+
+	for (; end - c >= 32; c += 32) {
+		uint32_t mask =
+			mask32(_mm256_cmpeq_epi8(load32(c), _mm256_set1_epi8('\n')));
+		const uint32_t offset = static_cast<uint32_t>(c - begin);
+
+		for (; mask; mask &= mask - 1)
+			*out++ = offset + static_cast<uint32_t>(__builtin_ctz(mask));
+	}
+
+	for (; c != end; ++c) {
+		if (*c == '\n')
+			*out++ = static_cast<uint32_t>(c - begin);
+	}
+}
+
+#undef SCAN_TARGET
+
+#endif // LLANG_SCAN_X86
+
+const Kernels scalarKernels = {
+	countNewlinesScalar,
+	findNewlinesScalar
+};
+
+#ifdef LLANG_SCAN_X86
+
+const Kernels sse2Kernels = {
+	countNewlinesSse2,
+	findNewlinesSse2
+};
+
+const Kernels avx2Kernels = {
+	countNewlinesAvx2,
+	findNewlinesAvx2
+};
+
+#endif
+
+Level detectLevel() {
+#ifdef LLANG_SCAN_X86
+	__builtin_cpu_init();
+
+	if (__builtin_cpu_supports("avx2")) return AVX2;
+	if (__builtin_cpu_supports("sse2")) return SSE2;
+#endif
+
+	return SCALAR;
+}
+
+const Level supportedLevel = detectLevel();
+Level currentLevel = SCALAR;
+
+} // namespace
+
+// Constant-initialized, so the scalar kernels work during static
+// initialization; the best supported ones are selected below.
+Kernels kernels = {
+	countNewlinesScalar,
+	findNewlinesScalar
+};
+
+Level level() {
+	return currentLevel;
+}
+
+Level maxLevel() {
+	return supportedLevel;
+}
+
+const char* levelName(Level level) {
+	switch (level) {
+	case SCALAR: return "scalar";
+	case SSE2: return "sse2";
+	case AVX2: return "avx2";
+	}
+
+	assert(false);
+	return 0;
+}
+
+void setLevel(Level level) {
+	assert(level <= supportedLevel);
+
+	switch (level) {
+#ifdef LLANG_SCAN_X86
+	case AVX2:
+		kernels = avx2Kernels;
+		break;
+
+	case SSE2:
+		kernels = sse2Kernels;
+		break;
+#endif
+
+	default:
+		kernels = scalarKernels;
+		break;
+	}
+
+	currentLevel = level;
+}
+
+namespace {
+
+const bool initialized = (setLevel(supportedLevel), true);
+
+} // namespace
+
+} // namespace scan
+} // namespace llang
@@ -0,0 +1,91 @@
+#ifndef LLANG_UTIL_SCAN_HPP_INCLUDED
+#define LLANG_UTIL_SCAN_HPP_INCLUDED
+
+#include <cstddef>
+#include <stdint.h>
+
+namespace llang {
+namespace scan {
+
+// Character classes of the source language. Unlike <cctype>, these don't
+// depend on the locale.
+enum CharClass {
+	WHITESPACE = 1 << 0, // ' ', '\t', '\n'
+	IDENTIFIER_START = 1 << 1, // [A-Za-z_]
+	IDENTIFIER = 1 << 2, // [A-Za-z0-9_]
+	DIGIT = 1 << 3 // [0-9]
+};
+
+extern const unsigned char charClasses[256];
+
+inline bool is(char c, CharClass charClass) {
+	return charClasses[static_cast<unsigned char>(c)] & charClass;
+}
+
+// Runs of whitespace, identifiers and digits in real code are only a few
+// bytes long, too short for SIMD to pay off; these plain loops are inlined
+// into the lexer.
+
+// Returns the first character that isn't whitespace
+inline const char* skipWhitespace(const char* c) {
+	while (is(*c, WHITESPACE)) ++c;
+	return c;
+}
+
+// Returns the first '\n' or '\0'
+inline const char* findLineEnd(const char* c) {
+	while (*c != '\n' && *c != '\0') ++c;
+	return c;
+}
+
+// Returns the first character that can't be part of an identifier
+inline const char* skipIdentifier(const char* c) {
+	while (is(*c, IDENTIFIER)) ++c;
+	return c;
+}
+
+// Returns the first character that isn't a digit
+inline const char* skipDigits(const char* c) {
+	while (is(*c, DIGIT)) ++c;
+	return c;
+}
+
+enum Level {
+	SCALAR,
+	SSE2,
+	AVX2
+};
+
+// Building the line table goes over whole files, where SIMD kernels are
+// several times faster. The best level supported by the CPU is selected on
+// startup.
+Level level();
+Level maxLevel();
+const char* levelName(Level level);
+
+// Switches to a lower level (for benchmarking)
+void setLevel(Level level);
+
+struct Kernels {
+	size_t (*countNewlines)(const char*, const char*);
+	void (*findNewlines)(const char*, const char*, uint32_t*);
+};
+
+extern Kernels kernels;
+
+// Number of '\n' in [begin, end). Doesn't read past end.
+inline size_t countNewlines(const char* begin, const char* end) {
+	return kernels.countNewlines(begin, end);
+}
+
+// Writes the offset (relative to begin) of every '\n' in [begin, end) to
+// out, which must have room for countNewlines(begin, end) entries. Doesn't
+// read past end.
+inline void findNewlines(const char* begin, const char* end, uint32_t* out) {
+	kernels.findNewlines(begin, end, out);
+}
+
+} // namespace scan
+} // namespace llang
+
+#endif
@@ -0,0 +1,167 @@
+#ifndef LLANG_UTIL_SMALL_VECTOR_HPP_INCLUDED
+#define LLANG_UTIL_SMALL_VECTOR_HPP_INCLUDED
+
+#include <cassert>
+#include <cstddef>
+#include <cstring>
+#include <stdint.h>
+#include <type_traits>
+
+namespace llang {
+
+// A vector that keeps up to N elements inline and only goes to the heap
+// when it grows past that. Elements are contiguous, so iterators are plain
+// pointers. It can be moved but not copied.
+//
+// Only for trivial types (the AST uses it for lists of node pointers), so
+// elements are moved around with memcpy and never constructed or destroyed.
+template <typename T, size_t N> class SmallVector {
+	static_assert(std::is_trivial<T>::value,
+	              "SmallVector only holds trivial types");
+
+public:
+	typedef T value_type;
+	typedef T* iterator;
+	typedef const T* const_iterator;
+
+	SmallVector()
+		: data_(inlineData()), size_(0), capacity_(N) {
+	}
+
+	SmallVector(SmallVector&& other)
+		: data_(inlineData()), size_(0), capacity_(N) {
+		take(other);
+	}
+
+	SmallVector& operator=(SmallVector&& other) {
+		if (this != &other) {
+			release();
+			take(other);
+		}
+
+		return *this;
+	}
+
+	~SmallVector() {
+		release();
+	}
+
+	iterator begin() { return data_; }
+	iterator end() { return data_ + size_; }
+	const_iterator begin() const { return data_; }
+	const_iterator end() const { return data_ + size_; }
+
+	size_t size() const { return size_; }
+	bool empty() const { return size_ == 0; }
+
+	T& operator[](size_t i) { assert(i < size_); return data_[i]; }
+	const T& operator[](size_t i) const { assert(i < size_); return data_[i]; }
+
+	T& front() { assert(size_); return data_[0]; }
+	T& back() { assert(size_); return data_[size_ - 1]; }
+	const T& front() const { assert(size_); return data_[0]; }
+	const T& back() const { assert(size_); return data_[size_ - 1]; }
+
+	void push_back(const T& value) {
+		if (size_ == capacity_)
+			grow(size_ + 1);
+
+		data_[size_++] = value;
+	}
+
+	void pop_back() {
+		assert(size_);
+		--size_;
+	}
+
+	void clear() {
+		size_ = 0;
+	}
+
+	void reserve(size_t capacity) {
+		if (capacity > capacity_)
+			grow(capacity);
+	}
+
+	// Inserts [first, last), which must not point into this vector, before
+	// position
+	iterator insert(iterator position, const T* first, const T* last) {
+		const size_t index = static_cast<size_t>(position - data_);
+		const size_t count = static_cast<size_t>(last - first);
+		assert(index <= size_);
+
+		reserve(size_ + count);
+		std::memmove(data_ + index + count, data_ + index,
+		             (size_ - index) * sizeof(T));
+		std::memcpy(data_ + index, first, count * sizeof(T));
+		size_ += static_cast<uint32_t>(count);
+
+		return data_ + index;
+	}
+
+	iterator erase(iterator first, iterator last) {
+		assert(data_ <= first && first <= last && last <= end());
+
+		std::memmove(first, last, static_cast<size_t>(end() - last) * sizeof(T));
+		size_ -= static_cast<uint32_t>(last - first);
+
+		return first;
+	}
+
+private:
+	SmallVector(const SmallVector&);
+	SmallVector& operator=(const SmallVector&);
+
+	T* inlineData() { return inline_; }
+	bool isInline() const { return data_ == inline_; }
+
+	void grow(size_t minCapacity) {
+		size_t capacity = capacity_ ? 2 * capacity_ : 4;
+		if (capacity < minCapacity)
+			capacity = minCapacity;
+
+		T* data = new T[capacity];
+		std::memcpy(data, data_, size_ * sizeof(T));
+
+		if (!isInline())
+			delete[] data_;
+
+		data_ = data;
+		capacity_ = static_cast<uint32_t>(capacity);
+	}
+
+	void release() {
+		if (!isInline())
+			delete[] data_;
+
+		data_ = inlineData();
+		size_ = 0;
+		capacity_ = N;
+	}
+
+	// Expects this to be empty and inline
+	void take(SmallVector& other) {
+		if (other.isInline()) {
+			std::memcpy(inline_, other.inline_, other.size_ * sizeof(T));
+		} else {
+			data_ = other.data_;
+			capacity_ = other.capacity_;
+		}
+
+		size_ = other.size_;
+
+		other.data_ = other.inlineData();
+		other.size_ = 0;
+		other.capacity_ = N;
+	}
+
+	T* data_;
+	uint32_t size_;
+	uint32_t capacity_;
+
+	T inline_[N ? N : 1];
+};
+
+} // namespace llang
+
+#endif